@@ -10,5 +10,6 @@ struct AABB
 	AABB(float minX, float minY, float maxX, float maxY);
 
 	bool isIntersecting(const AABB& other) const;
+	bool contains(const glm::vec2& point) const;
 };
 
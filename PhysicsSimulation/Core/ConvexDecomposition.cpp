@@ -0,0 +1,320 @@
+#include "ConvexDecomposition.h"
+#include "CoreMath.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+	const float EPSILON = 1e-9f;
+
+	bool isPointInTriangle(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b, const glm::vec2& c)
+	{
+		// Triangle is counter-clockwise, so point is inside if it's on the left of (or on) every edge
+		return CoreMath::cross(b - a, p - a) >= 0.0f &&
+			CoreMath::cross(c - b, p - b) >= 0.0f &&
+			CoreMath::cross(a - c, p - c) >= 0.0f;
+	}
+
+	bool isConvexLoop(const std::vector<glm::vec2>& vertices, const std::vector<int>& loop)
+	{
+		size_t n = loop.size();
+		for (size_t i = 0; i < n; i++)
+		{
+			const glm::vec2& a = vertices[loop[(i + n - 1) % n]];
+			const glm::vec2& b = vertices[loop[i]];
+			const glm::vec2& c = vertices[loop[(i + 1) % n]];
+			if (CoreMath::cross(b - a, c - b) < -EPSILON)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool triangulate(const std::vector<glm::vec2>& vertices, std::vector<std::vector<int>>& triangles)
+	{
+		std::vector<int> remaining(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			remaining[i] = (int)i;
+		}
+
+		while (remaining.size() > 3)
+		{
+			bool earFound = false;
+			size_t n = remaining.size();
+			for (size_t i = 0; i < n; i++)
+			{
+				int prev = remaining[(i + n - 1) % n];
+				int cur = remaining[i];
+				int next = remaining[(i + 1) % n];
+
+				const glm::vec2& a = vertices[prev];
+				const glm::vec2& b = vertices[cur];
+				const glm::vec2& c = vertices[next];
+
+				float cross = CoreMath::cross(b - a, c - b);
+				if (fabsf(cross) <= EPSILON)
+				{
+					// Collinear vertex doesn't change the shape, drop it
+					remaining.erase(remaining.begin() + i);
+					earFound = true;
+					break;
+				}
+				if (cross < 0.0f)
+				{
+					// Reflex vertex
+					continue;
+				}
+
+				bool isEar = true;
+				for (int index : remaining)
+				{
+					if (index == prev || index == cur || index == next)
+					{
+						continue;
+					}
+
+					const glm::vec2& p = vertices[index];
+					if (p == a || p == b || p == c)
+					{
+						continue;
+					}
+
+					if (isPointInTriangle(p, a, b, c))
+					{
+						isEar = false;
+						break;
+					}
+				}
+
+				if (isEar)
+				{
+					triangles.push_back({ prev, cur, next });
+					remaining.erase(remaining.begin() + i);
+					earFound = true;
+					break;
+				}
+			}
+
+			if (!earFound)
+			{
+				return false;
+			}
+		}
+
+		if (remaining.size() == 3)
+		{
+			triangles.push_back(remaining);
+		}
+		return true;
+	}
+
+	bool tryMerge(const std::vector<glm::vec2>& vertices, const std::vector<int>& pieceA, const std::vector<int>& pieceB, std::vector<int>& merged)
+	{
+		size_t countA = pieceA.size();
+		size_t countB = pieceB.size();
+
+		for (size_t k = 0; k < countA; k++)
+		{
+			int a = pieceA[k];
+			int b = pieceA[(k + 1) % countA];
+
+			// Diagonal a->b of the first piece is b->a in the second one
+			for (size_t m = 0; m < countB; m++)
+			{
+				if (pieceB[m] != b || pieceB[(m + 1) % countB] != a)
+				{
+					continue;
+				}
+
+				merged.clear();
+				for (size_t i = 0; i < countA; i++)
+				{
+					merged.push_back(pieceA[(k + 1 + i) % countA]);
+				}
+				for (size_t i = 2; i < countB; i++)
+				{
+					merged.push_back(pieceB[(m + i) % countB]);
+				}
+
+				return isConvexLoop(vertices, merged);
+			}
+		}
+		return false;
+	}
+}
+
+namespace ConvexDecomposition
+{
+	float signedArea(const std::vector<glm::vec2>& vertices)
+	{
+		float area = 0.0f;
+		size_t n = vertices.size();
+		for (size_t i = 0; i < n; i++)
+		{
+			area += CoreMath::cross(vertices[i], vertices[(i + 1) % n]);
+		}
+		return area * 0.5f;
+	}
+
+	bool isConvex(const std::vector<glm::vec2>& vertices)
+	{
+		size_t n = vertices.size();
+		if (n < 4)
+		{
+			return true;
+		}
+
+		bool hasPositive = false, hasNegative = false;
+		float turning = 0.0f;
+		for (size_t i = 0; i < n; i++)
+		{
+			const glm::vec2& a = vertices[i];
+			const glm::vec2& b = vertices[(i + 1) % n];
+			const glm::vec2& c = vertices[(i + 2) % n];
+
+			float cross = CoreMath::cross(b - a, c - b);
+			turning += atan2f(cross, glm::dot(b - a, c - b));
+			if (cross > EPSILON)
+			{
+				hasPositive = true;
+			}
+			else if (cross < -EPSILON)
+			{
+				hasNegative = true;
+			}
+
+			if (hasPositive && hasNegative)
+			{
+				return false;
+			}
+		}
+
+		// Self-intersecting polygon, like a pentagram, turns the same way at every vertex, but goes around more than once
+		return fabsf(turning) < 3.0f * (float)M_PI;
+	}
+
+	std::vector<std::vector<glm::vec2>> decompose(const std::vector<glm::vec2>& vertices_, size_t maxPieceVertices)
+	{
+		std::vector<glm::vec2> vertices = vertices_;
+		if (signedArea(vertices) < 0.0f)
+		{
+			std::reverse(vertices.begin(), vertices.end());
+		}
+
+		std::vector<std::vector<int>> pieces;
+		if (!triangulate(vertices, pieces))
+		{
+			return splitConvex(convexHull(vertices), maxPieceVertices);
+		}
+
+		// Hertel-Mehlhorn: remove diagonals, that aren't essential for convexity
+		std::vector<int> merged;
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (size_t i = 0; i < pieces.size() && !changed; i++)
+			{
+				for (size_t j = i + 1; j < pieces.size(); j++)
+				{
+					if (pieces[i].size() + pieces[j].size() - 2 > maxPieceVertices)
+					{
+						continue;
+					}
+
+					if (tryMerge(vertices, pieces[i], pieces[j], merged))
+					{
+						pieces[i] = merged;
+						pieces.erase(pieces.begin() + j);
+						changed = true;
+						break;
+					}
+				}
+			}
+		}
+
+		std::vector<std::vector<glm::vec2>> result;
+		result.reserve(pieces.size());
+		for (const auto& piece : pieces)
+		{
+			std::vector<glm::vec2> pieceVertices;
+			pieceVertices.reserve(piece.size());
+			for (int index : piece)
+			{
+				pieceVertices.push_back(vertices[index]);
+			}
+			result.push_back(std::move(pieceVertices));
+		}
+		return result;
+	}
+
+	std::vector<std::vector<glm::vec2>> splitConvex(const std::vector<glm::vec2>& vertices, size_t maxPieceVertices)
+	{
+		size_t n = vertices.size();
+		if (n <= maxPieceVertices)
+		{
+			return { vertices };
+		}
+
+		// Every piece shares the first vertex and continues where the previous one ended
+		std::vector<std::vector<glm::vec2>> pieces;
+		size_t start = 1;
+		while (start < n - 1)
+		{
+			size_t end = std::min(start + maxPieceVertices - 2, n - 1);
+
+			std::vector<glm::vec2> piece;
+			piece.reserve(end - start + 2);
+			piece.push_back(vertices[0]);
+			for (size_t i = start; i <= end; i++)
+			{
+				piece.push_back(vertices[i]);
+			}
+			pieces.push_back(std::move(piece));
+
+			start = end;
+		}
+		return pieces;
+	}
+
+	std::vector<glm::vec2> convexHull(const std::vector<glm::vec2>& vertices)
+	{
+		std::vector<glm::vec2> points = vertices;
+		std::sort(points.begin(), points.end(), [](const glm::vec2& a, const glm::vec2& b)
+			{
+				return a.x < b.x || (a.x == b.x && a.y < b.y);
+			});
+
+		size_t n = points.size();
+		if (n < 3)
+		{
+			return points;
+		}
+
+		// Andrew's monotone chain
+		std::vector<glm::vec2> hull(2 * n);
+		size_t k = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			while (k >= 2 && CoreMath::cross(hull[k - 1] - hull[k - 2], points[i] - hull[k - 2]) <= 0.0f)
+			{
+				k--;
+			}
+			hull[k++] = points[i];
+		}
+		for (size_t i = n - 1, t = k + 1; i > 0; i--)
+		{
+			while (k >= t && CoreMath::cross(hull[k - 1] - hull[k - 2], points[i - 1] - hull[k - 2]) <= 0.0f)
+			{
+				k--;
+			}
+			hull[k++] = points[i - 1];
+		}
+		hull.resize(k - 1);
+		return hull;
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace ConvexDecomposition
+{
+	float signedArea(const std::vector<glm::vec2>& vertices);
+	bool isConvex(const std::vector<glm::vec2>& vertices);
+
+	// Splits a simple polygon into convex pieces (ear clipping + Hertel-Mehlhorn merging) with at most maxPieceVertices vertices.
+	// Pieces are returned in counter-clockwise order. If the polygon can't be triangulated (self-intersecting),
+	// its convex hull is used instead.
+	std::vector<std::vector<glm::vec2>> decompose(const std::vector<glm::vec2>& vertices, size_t maxPieceVertices);
+
+	// Splits a convex polygon into fan of convex pieces with at most maxPieceVertices vertices
+	std::vector<std::vector<glm::vec2>> splitConvex(const std::vector<glm::vec2>& vertices, size_t maxPieceVertices);
+
+	std::vector<glm::vec2> convexHull(const std::vector<glm::vec2>& vertices);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+
+// Vector with inline storage of fixed capacity. Doesn't allocate, so data lives right inside the owner
+template<typename T, size_t Capacity>
+class FixedVector
+{
+	T items[Capacity];
+	size_t count = 0;
+public:
+	FixedVector() = default;
+
+	template<typename Container>
+	explicit FixedVector(const Container& container)
+	{
+		assign(container.data(), container.size());
+	}
+
+	void assign(const T* data, size_t size)
+	{
+		assert(size <= Capacity);
+		count = size;
+		for (size_t i = 0; i < size; i++)
+		{
+			items[i] = data[i];
+		}
+	}
+
+	void push_back(const T& item)
+	{
+		assert(count < Capacity);
+		items[count++] = item;
+	}
+
+	void resize(size_t size)
+	{
+		assert(size <= Capacity);
+		count = size;
+	}
+
+	void clear() { count = 0; }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	static constexpr size_t capacity() { return Capacity; }
+
+	T* data() { return items; }
+	const T* data() const { return items; }
+
+	T& operator[](size_t index) { return items[index]; }
+	const T& operator[](size_t index) const { return items[index]; }
+
+	T* begin() { return items; }
+	T* end() { return items + count; }
+	const T* begin() const { return items; }
+	const T* end() const { return items + count; }
+};
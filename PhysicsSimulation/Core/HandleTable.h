@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+
+// Slot of object and generation of the slot, when handle was made. Tag only keeps handles of different objects apart
+template<typename Tag>
+struct Handle
+{
+	unsigned int index = 0;
+	unsigned int generation = 0; // Slots start from generation 1, so default handle is never valid
+
+	bool operator==(const Handle& other) const
+	{
+		return index == other.index && generation == other.generation;
+	}
+
+	bool operator!=(const Handle& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// Maps stable handles to values. Removed slot gets next generation and is reused, so handles of removed objects are detected instead of reaching new ones
+template<typename T, typename Tag>
+class HandleTable
+{
+	struct Slot
+	{
+		T value;
+		unsigned int generation = 1;
+		bool used = false;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<unsigned int> freeSlots;
+	size_t countOfUsed = 0;
+public:
+	Handle<Tag> add(const T& value)
+	{
+		unsigned int index;
+		if (freeSlots.empty())
+		{
+			index = (unsigned int)slots.size();
+			slots.emplace_back();
+		}
+		else
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+
+		Slot& slot = slots[index];
+		slot.value = value;
+		slot.used = true;
+		countOfUsed++;
+		return { index, slot.generation };
+	}
+
+	bool remove(Handle<Tag> handle)
+	{
+		if (!isValid(handle))
+		{
+			return false;
+		}
+
+		Slot& slot = slots[handle.index];
+		slot.used = false;
+		slot.generation++;
+		freeSlots.push_back(handle.index);
+		countOfUsed--;
+		return true;
+	}
+
+	bool isValid(Handle<Tag> handle) const
+	{
+		return handle.index < slots.size() && slots[handle.index].used && slots[handle.index].generation == handle.generation;
+	}
+
+	// Returns nullptr for invalid handle
+	T* find(Handle<Tag> handle)
+	{
+		return isValid(handle) ? &slots[handle.index].value : nullptr;
+	}
+
+	const T* find(Handle<Tag> handle) const
+	{
+		return isValid(handle) ? &slots[handle.index].value : nullptr;
+	}
+
+	// Value of used slot by its index. Owner updates it, when object moves
+	T& at(unsigned int index)
+	{
+		return slots[index].value;
+	}
+
+	Handle<Tag> getHandle(unsigned int index) const
+	{
+		return { index, slots[index].generation };
+	}
+
+	size_t size() const
+	{
+		return countOfUsed;
+	}
+};
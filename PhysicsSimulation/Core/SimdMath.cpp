@@ -0,0 +1,227 @@
+#include "SimdMath.h"
+
+#include <math.h>
+#include <float.h>
+
+#ifdef SIMD_SSE2
+#include <emmintrin.h>
+
+namespace
+{
+	// Sine of four angles. Range is reduced to [-pi/2, pi/2], then odd polynomial is used (error is in order of 1e-6)
+	__m128 sin4(__m128 x)
+	{
+		const __m128 invTwoPi = _mm_set1_ps(0.15915494309f);
+		const __m128 twoPiHi = _mm_set1_ps(6.28125f);
+		const __m128 twoPiLo = _mm_set1_ps(1.9353071795864769253e-3f);
+		const __m128 pi = _mm_set1_ps(3.14159265359f);
+		const __m128 halfPi = _mm_set1_ps(1.57079632679f);
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+
+		// x -= 2pi * round(x / 2pi), in two steps to keep precision
+		__m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, invTwoPi)));
+		x = _mm_sub_ps(x, _mm_mul_ps(k, twoPiHi));
+		x = _mm_sub_ps(x, _mm_mul_ps(k, twoPiLo));
+
+		// sin(x) = sin(sign(x) * pi - x), that brings |x| > pi/2 back into [-pi/2, pi/2]
+		__m128 sign = _mm_and_ps(x, signMask);
+		__m128 absX = _mm_andnot_ps(signMask, x);
+		__m128 reflected = _mm_sub_ps(_mm_or_ps(pi, sign), x);
+		__m128 mask = _mm_cmpgt_ps(absX, halfPi);
+		x = _mm_or_ps(_mm_and_ps(mask, reflected), _mm_andnot_ps(mask, x));
+
+		// Taylor series up to x^11
+		__m128 x2 = _mm_mul_ps(x, x);
+		__m128 p = _mm_set1_ps(-2.5052108385e-8f);
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(2.7557319224e-6f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.9841269841e-4f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(8.3333333333e-3f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.6666666667e-1f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f));
+		return _mm_mul_ps(p, x);
+	}
+
+	// (f0, f1) -> (f0, f0, f1, f1), so each factor scales both components of its vector
+	__m128 loadPairFactors(const float* factors)
+	{
+		__m128 factor = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(factors)));
+		return _mm_unpacklo_ps(factor, factor);
+	}
+}
+#endif
+
+namespace SimdMath
+{
+	void cosSin(const float* angles, glm::vec2* outCosSin, size_t count)
+	{
+		size_t i = 0;
+
+#ifdef SIMD_SSE2
+		const __m128 halfPi = _mm_set1_ps(1.57079632679f);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 angle = _mm_loadu_ps(angles + i);
+			__m128 sin = sin4(angle);
+			__m128 cos = sin4(_mm_add_ps(angle, halfPi));
+
+			// Interleave into (cos, sin) pairs
+			float* out = reinterpret_cast<float*>(outCosSin + i);
+			_mm_storeu_ps(out, _mm_unpacklo_ps(cos, sin));
+			_mm_storeu_ps(out + 4, _mm_unpackhi_ps(cos, sin));
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			outCosSin[i] = { cosf(angles[i]), sinf(angles[i]) };
+		}
+	}
+
+	AABB transformPoints(const glm::vec2* in, glm::vec2* out, size_t count, const glm::vec2& cosSin, const glm::vec2& translation)
+	{
+		size_t i = 0;
+		AABB bounds = { glm::vec2(FLT_MAX), glm::vec2(-FLT_MAX) };
+
+#ifdef SIMD_SSE2
+		// Two points per register: (x0, y0, x1, y1)
+		const __m128 cos = _mm_set1_ps(cosSin.x);
+		const __m128 sin = _mm_setr_ps(-cosSin.y, cosSin.y, -cosSin.y, cosSin.y);
+		const __m128 trans = _mm_setr_ps(translation.x, translation.y, translation.x, translation.y);
+
+		__m128 minV = _mm_set1_ps(FLT_MAX);
+		__m128 maxV = _mm_set1_ps(-FLT_MAX);
+		for (; i + 2 <= count; i += 2)
+		{
+			__m128 p = _mm_loadu_ps(reinterpret_cast<const float*>(in + i));
+			__m128 swapped = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 3, 0, 1));
+
+			// (x * cos - y * sin, y * cos + x * sin)
+			__m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p, cos), _mm_mul_ps(swapped, sin)), trans);
+			_mm_storeu_ps(reinterpret_cast<float*>(out + i), result);
+
+			minV = _mm_min_ps(minV, result);
+			maxV = _mm_max_ps(maxV, result);
+		}
+
+		float minArray[4], maxArray[4];
+		_mm_storeu_ps(minArray, minV);
+		_mm_storeu_ps(maxArray, maxV);
+		bounds.min = glm::min(glm::vec2(minArray[0], minArray[1]), glm::vec2(minArray[2], minArray[3]));
+		bounds.max = glm::max(glm::vec2(maxArray[0], maxArray[1]), glm::vec2(maxArray[2], maxArray[3]));
+#endif
+
+		for (; i < count; i++)
+		{
+			const glm::vec2& p = in[i];
+			glm::vec2 result =
+			{
+				p.x * cosSin.x - p.y * cosSin.y + translation.x,
+				p.x * cosSin.y + p.y * cosSin.x + translation.y
+			};
+			out[i] = result;
+
+			bounds.min = glm::min(bounds.min, result);
+			bounds.max = glm::max(bounds.max, result);
+		}
+		return bounds;
+	}
+
+	void addScaled(float* values, const float* deltas, const float* factors, float scale, size_t count)
+	{
+		size_t i = 0;
+
+#ifdef SIMD_SSE2
+		const __m128 scale4 = _mm_set1_ps(scale);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 delta = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(deltas + i), _mm_loadu_ps(factors + i)), scale4);
+			_mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), delta));
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			values[i] += deltas[i] * factors[i] * scale;
+		}
+	}
+
+	void addScaled(glm::vec2* values, const glm::vec2* deltas, const float* factors, float scale, size_t count)
+	{
+		size_t i = 0;
+
+#ifdef SIMD_SSE2
+		const __m128 scale4 = _mm_set1_ps(scale);
+		for (; i + 2 <= count; i += 2)
+		{
+			float* out = reinterpret_cast<float*>(values + i);
+			__m128 delta = _mm_mul_ps(_mm_loadu_ps(reinterpret_cast<const float*>(deltas + i)), _mm_mul_ps(loadPairFactors(factors + i), scale4));
+			_mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), delta));
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			values[i] += deltas[i] * (factors[i] * scale);
+		}
+	}
+
+	void addScaledSum(float* values, const float* deltasA, const float* deltasB, const float* factors, float scale, size_t count)
+	{
+		size_t i = 0;
+
+#ifdef SIMD_SSE2
+		const __m128 scale4 = _mm_set1_ps(scale);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 delta = _mm_add_ps(_mm_loadu_ps(deltasA + i), _mm_loadu_ps(deltasB + i));
+			delta = _mm_mul_ps(_mm_mul_ps(delta, _mm_loadu_ps(factors + i)), scale4);
+			_mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), delta));
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			values[i] += (deltasA[i] + deltasB[i]) * factors[i] * scale;
+		}
+	}
+
+	void addScaledSum(glm::vec2* values, const glm::vec2* deltasA, const glm::vec2* deltasB, const float* factors, float scale, size_t count)
+	{
+		size_t i = 0;
+
+#ifdef SIMD_SSE2
+		const __m128 scale4 = _mm_set1_ps(scale);
+		for (; i + 2 <= count; i += 2)
+		{
+			float* out = reinterpret_cast<float*>(values + i);
+			__m128 delta = _mm_add_ps(_mm_loadu_ps(reinterpret_cast<const float*>(deltasA + i)), _mm_loadu_ps(reinterpret_cast<const float*>(deltasB + i)));
+			delta = _mm_mul_ps(delta, _mm_mul_ps(loadPairFactors(factors + i), scale4));
+			_mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), delta));
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			values[i] += (deltasA[i] + deltasB[i]) * (factors[i] * scale);
+		}
+	}
+
+	void addScaledVector(glm::vec2* values, const float* factors, const glm::vec2& vector, size_t count)
+	{
+		size_t i = 0;
+
+#ifdef SIMD_SSE2
+		const __m128 vector2 = _mm_setr_ps(vector.x, vector.y, vector.x, vector.y);
+		for (; i + 2 <= count; i += 2)
+		{
+			float* out = reinterpret_cast<float*>(values + i);
+			_mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), _mm_mul_ps(vector2, loadPairFactors(factors + i))));
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			values[i] += vector * factors[i];
+		}
+	}
+}
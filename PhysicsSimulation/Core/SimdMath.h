@@ -0,0 +1,28 @@
+#pragma once
+#include "AABB.h"
+#include <cstddef>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#endif
+
+// Batched math, that works on several values at once. Falls back to scalar code, if SSE2 isn't available
+namespace SimdMath
+{
+	// Fills outCosSin[i] with (cos(angles[i]), sin(angles[i]))
+	void cosSin(const float* angles, glm::vec2* outCosSin, size_t count);
+
+	// out[i] = rotate(in[i], cosSin) + translation. Returns bounds of transformed points
+	AABB transformPoints(const glm::vec2* in, glm::vec2* out, size_t count, const glm::vec2& cosSin, const glm::vec2& translation);
+
+	// values[i] += deltas[i] * factors[i] * scale
+	void addScaled(float* values, const float* deltas, const float* factors, float scale, size_t count);
+	void addScaled(glm::vec2* values, const glm::vec2* deltas, const float* factors, float scale, size_t count);
+
+	// values[i] += (deltasA[i] + deltasB[i]) * factors[i] * scale
+	void addScaledSum(float* values, const float* deltasA, const float* deltasB, const float* factors, float scale, size_t count);
+	void addScaledSum(glm::vec2* values, const glm::vec2* deltasA, const glm::vec2* deltasB, const float* factors, float scale, size_t count);
+
+	// values[i] += vector * factors[i]
+	void addScaledVector(glm::vec2* values, const float* factors, const glm::vec2& vector, size_t count);
+}
@@ -81,10 +81,14 @@ void ShapeRenderer::drawCircle(const glm::vec2& position, float radius, const gl
 }
 
 void ShapeRenderer::drawPolygon(const std::vector<glm::vec2>& vertices, const glm::vec3& color, bool isOutline)
+{
+	drawPolygon(vertices.data(), vertices.size(), color, isOutline);
+}
+
+void ShapeRenderer::drawPolygon(const glm::vec2* vertices, size_t verticesCount, const glm::vec3& color, bool isOutline)
 {
 	if (isOutline)
 	{
-		size_t verticesCount = vertices.size();
 		if (verticesCount + 1 > polygonShapeMaxVertices)
 		{
 			return;
@@ -93,8 +97,8 @@ void ShapeRenderer::drawPolygon(const std::vector<glm::vec2>& vertices, const gl
 		srData->polygonShader->use();
 		srData->polygonVAO.bind();
 
-		srData->polygonVBO.rewriteData(vertices.data(), verticesCount * sizeof(float) * 2);
-		srData->polygonVBO.rewriteData(vertices.data(), sizeof(float) * 2, verticesCount * sizeof(float) * 2);
+		srData->polygonVBO.rewriteData(vertices, verticesCount * sizeof(float) * 2);
+		srData->polygonVBO.rewriteData(vertices, sizeof(float) * 2, verticesCount * sizeof(float) * 2);
 
 		srData->polygonShader->setVec3("color", color.x, color.y, color.z);
 
@@ -102,7 +106,6 @@ void ShapeRenderer::drawPolygon(const std::vector<glm::vec2>& vertices, const gl
 	}
 	else
 	{
-		size_t verticesCount = vertices.size();
 		if (verticesCount > polygonShapeMaxVertices)
 		{
 			return;
@@ -111,7 +114,7 @@ void ShapeRenderer::drawPolygon(const std::vector<glm::vec2>& vertices, const gl
 		srData->polygonShader->use();
 		srData->polygonVAO.bind();
 
-		srData->polygonVBO.rewriteData(vertices.data(), verticesCount * sizeof(float) * 2);
+		srData->polygonVBO.rewriteData(vertices, verticesCount * sizeof(float) * 2);
 
 		srData->polygonShader->setVec3("color", color.x, color.y, color.z);
 
@@ -35,5 +35,6 @@ public:
 
 	static void drawCircle(const glm::vec2& position, float radius, const glm::vec3& color);
 	static void drawPolygon(const std::vector<glm::vec2>& vertices, const glm::vec3& color, bool isOutline = false);
+	static void drawPolygon(const glm::vec2* vertices, size_t verticesCount, const glm::vec3& color, bool isOutline = false);
 };
 
@@ -0,0 +1,156 @@
+#include "BodyStorage.h"
+
+#include "Core/SimdMath.h"
+
+#include <utility>
+
+void BodyStorage::registerBody(RigidBody* body)
+{
+	body->handle = handles.add(body);
+	bodies.push_back(body);
+
+	movedBodies.resize(bodies.size());
+	rotations.resize(bodies.size());
+	cosSin.resize(bodies.size());
+}
+
+template<typename Body, typename... Args>
+Body* BodyStorage::emplace(std::deque<Body>& pool, std::vector<Body*>& freeBodies, Args&&... args)
+{
+	// Body writes its motion state at the end of arrays
+	const unsigned int index = (unsigned int)bodies.size();
+	states.resize(index + 1);
+
+	Body* body;
+	if (freeBodies.empty())
+	{
+		pool.emplace_back(states, index, std::forward<Args>(args)...);
+		body = &pool.back();
+	}
+	else
+	{
+		body = freeBodies.back();
+		freeBodies.pop_back();
+		*body = Body(states, index, std::forward<Args>(args)...);
+	}
+
+	registerBody(body);
+	return body;
+}
+
+RigidCircle* BodyStorage::addCircle(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, float radius)
+{
+	return emplace(circles, freeCircles, pos, vel, rot, angVel, mass, inertia, material, radius);
+}
+
+RigidPolygon* BodyStorage::addPolygon(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<glm::vec2>& vertices)
+{
+	return emplace(polygons, freePolygons, pos, vel, rot, angVel, mass, inertia, material, vertices);
+}
+
+RigidCompound* BodyStorage::addCompound(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<CompoundShape>& shapes)
+{
+	return emplace(compounds, freeCompounds, pos, vel, rot, angVel, mass, inertia, material, shapes);
+}
+
+bool BodyStorage::removeBody(BodyHandle handle)
+{
+	RigidBody* body = getBody(handle);
+	if (!body)
+	{
+		return false;
+	}
+	handles.remove(handle);
+
+	const unsigned int index = body->bodyIndex;
+	bodies[index] = bodies.back();
+	bodies[index]->bodyIndex = index;
+	bodies.pop_back();
+	states.copy(states.size() - 1, index);
+	states.resize(bodies.size());
+
+	switch (body->shapeType)
+	{
+	case ShapeType::Circle:
+		freeCircles.push_back(static_cast<RigidCircle*>(body));
+		break;
+	case ShapeType::Polygon:
+		freePolygons.push_back(static_cast<RigidPolygon*>(body));
+		break;
+	case ShapeType::Compound:
+		freeCompounds.push_back(static_cast<RigidCompound*>(body));
+		break;
+	}
+	return true;
+}
+
+RigidBody* BodyStorage::getBody(BodyHandle handle) const
+{
+	RigidBody* const* body = handles.find(handle);
+	return body ? *body : nullptr;
+}
+
+bool BodyStorage::isValid(BodyHandle handle) const
+{
+	return handles.isValid(handle);
+}
+
+void BodyStorage::updateTransforms(size_t first, size_t last)
+{
+	size_t count = 0;
+	for (size_t i = first; i < last; i++)
+	{
+		RigidBody* body = bodies[i];
+		if (body->shapeType == ShapeType::Circle)
+		{
+			// Circle's AABB is cheap, so it's refreshed at once, if body was moved through state arrays
+			body->forceToUpdateAABB();
+		}
+		else if (body->isTransformUpdateRequired())
+		{
+			movedBodies[first + count] = body;
+			rotations[first + count] = body->getRotation();
+			count++;
+		}
+	}
+
+	SimdMath::cosSin(rotations.data() + first, cosSin.data() + first, count);
+
+	for (size_t i = first; i < first + count; i++)
+	{
+		RigidBody* body = movedBodies[i];
+		if (body->shapeType == ShapeType::Polygon)
+		{
+			static_cast<RigidPolygon*>(body)->updateTransform(cosSin[i]);
+		}
+		else
+		{
+			static_cast<RigidCompound*>(body)->updateTransform(cosSin[i]);
+		}
+	}
+}
+
+const std::vector<RigidBody*>& BodyStorage::getBodies() const
+{
+	return bodies;
+}
+
+BodyStates& BodyStorage::getStates()
+{
+	return states;
+}
+
+const BodyStates& BodyStorage::getStates() const
+{
+	return states;
+}
+
+size_t BodyStorage::getCountOfRanges() const
+{
+	return (bodies.size() + BODIES_PER_RANGE - 1) / BODIES_PER_RANGE;
+}
+
+size_t BodyStorage::size() const
+{
+	return bodies.size();
+}
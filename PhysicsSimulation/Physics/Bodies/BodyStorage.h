@@ -0,0 +1,73 @@
+#pragma once
+#include "RigidCircle.h"
+#include "RigidPolygon.h"
+#include "RigidCompound.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+// Owns bodies. Each shape has its own pool, so bodies of the same shape lie together. Pools don't move bodies, so pointers to bodies stay valid.
+// Motion state of bodies lives in states by body index. Removed body leaves the list of bodies at once, its place in pool is reused by the next body of the same shape
+class BodyStorage
+{
+	std::deque<RigidCircle> circles;
+	std::deque<RigidPolygon> polygons;
+	std::deque<RigidCompound> compounds;
+	std::vector<RigidCircle*> freeCircles;
+	std::vector<RigidPolygon*> freePolygons;
+	std::vector<RigidCompound*> freeCompounds;
+
+	std::vector<RigidBody*> bodies; // By body index
+	HandleTable<RigidBody*, RigidBody> handles;
+	BodyStates states;
+
+	// Bodies, whose transforms are refreshed, are packed from the start of their range, so ranges don't overlap
+	std::vector<RigidBody*> movedBodies;
+	std::vector<float> rotations;
+	std::vector<glm::vec2> cosSin;
+
+	const size_t BODIES_PER_RANGE = 4096;
+
+	void registerBody(RigidBody* body);
+
+	template<typename Body, typename... Args>
+	Body* emplace(std::deque<Body>& pool, std::vector<Body*>& freeBodies, Args&&... args);
+public:
+	RigidCircle* addCircle(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, float radius);
+	RigidPolygon* addPolygon(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<glm::vec2>& vertices);
+	RigidCompound* addCompound(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<CompoundShape>& shapes);
+
+	// Last body takes index of removed one, so list of bodies stays dense. Returns false for invalid handle
+	bool removeBody(BodyHandle handle);
+
+	// Returns nullptr for invalid handle
+	RigidBody* getBody(BodyHandle handle) const;
+	bool isValid(BodyHandle handle) const;
+
+	// Refreshes AABBs of moved circles and transforms of moved polygons and compounds of range with one batched sin/cos pass, so detection doesn't visit them again
+	void updateTransforms(size_t first, size_t last);
+
+	// Calls func(range, first, last) for ranges of body indices in parallel. Small scenes are one range, that is processed on calling thread
+	template<typename Func>
+	void forEachRange(Func func) const;
+	size_t getCountOfRanges() const;
+
+	const std::vector<RigidBody*>& getBodies() const;
+	BodyStates& getStates();
+	const BodyStates& getStates() const;
+
+	size_t size() const;
+};
+
+template<typename Func>
+void BodyStorage::forEachRange(Func func) const
+{
+	const size_t count = bodies.size();
+	ParallelUtils::parallelFor(0, getCountOfRanges(), 1, [this, count, &func](size_t range)
+		{
+			size_t first = range * BODIES_PER_RANGE;
+			func(range, first, std::min(first + BODIES_PER_RANGE, count));
+		});
+}
@@ -0,0 +1,103 @@
+#include "MaterialTable.h"
+
+#include <math.h>
+#include <cassert>
+
+Material::Material(float elasticity, float staticFriction, float dynamicFriction)
+	: elasticity(elasticity), staticFriction(staticFriction), dynamicFriction(dynamicFriction)
+{
+}
+
+MaterialPair MaterialTable::mixDefault(const Material& a, const Material& b)
+{
+	MaterialPair pair;
+	pair.elasticity = fmaxf(a.elasticity, b.elasticity);
+	pair.staticFriction = (a.staticFriction + b.staticFriction) * 0.5f;
+	pair.dynamicFriction = (a.dynamicFriction + b.dynamicFriction) * 0.5f;
+	return pair;
+}
+
+MaterialTable::MaterialTable() : mixFunction(mixDefault)
+{
+	addMaterial(Material());
+}
+
+void MaterialTable::rebuild()
+{
+	const size_t count = materials.size();
+	pairs.resize(count * count);
+
+	for (size_t a = 0; a < count; a++)
+	{
+		for (size_t b = a; b < count; b++)
+		{
+			MaterialPair pair = mixFunction(materials[a], materials[b]);
+			pairs[a * count + b] = pair;
+			pairs[b * count + a] = pair;
+		}
+	}
+
+	for (const auto& entry : overrides)
+	{
+		pairs[entry.a * count + entry.b] = entry.pair;
+		pairs[entry.b * count + entry.a] = entry.pair;
+	}
+}
+
+MaterialId MaterialTable::addMaterial(const Material& material)
+{
+	assert(materials.size() < UINT16_MAX);
+
+	materials.push_back(material);
+	rebuild();
+	return MaterialId(materials.size() - 1);
+}
+
+void MaterialTable::setMaterial(MaterialId id, const Material& material)
+{
+	assert(id < materials.size());
+
+	materials[id] = material;
+	rebuild();
+}
+
+const Material& MaterialTable::getMaterial(MaterialId id) const
+{
+	assert(id < materials.size());
+
+	return materials[id];
+}
+
+size_t MaterialTable::getCountOfMaterials() const
+{
+	return materials.size();
+}
+
+bool MaterialTable::isValid(MaterialId id) const
+{
+	return id < materials.size();
+}
+
+void MaterialTable::setMixFunction(const MaterialMixFunction& function)
+{
+	mixFunction = function;
+	rebuild();
+}
+
+void MaterialTable::setPair(MaterialId a, MaterialId b, const MaterialPair& pair)
+{
+	assert(a < materials.size() && b < materials.size());
+
+	for (auto& entry : overrides)
+	{
+		if ((entry.a == a && entry.b == b) || (entry.a == b && entry.b == a))
+		{
+			entry.pair = pair;
+			rebuild();
+			return;
+		}
+	}
+
+	overrides.push_back({ a, b, pair });
+	rebuild();
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Index of material in simulation's material table
+using MaterialId = uint16_t;
+
+// Registered by table itself, so bodies always have a valid material
+constexpr MaterialId DEFAULT_MATERIAL = 0;
+
+struct Material
+{
+	float elasticity = 1.0f;
+	float staticFriction = 0.0f, dynamicFriction = 0.0f;
+
+	Material() = default;
+	Material(float elasticity, float staticFriction, float dynamicFriction);
+};
+
+// Coefficients of contact between two materials
+struct MaterialPair
+{
+	float elasticity;
+	float staticFriction, dynamicFriction;
+};
+
+using MaterialMixFunction = std::function<MaterialPair(const Material&, const Material&)>;
+
+// Registered materials and N x N table of their combined coefficients. Table is rebuilt when materials or rules change,
+// so solver only does a lookup per contact
+class MaterialTable
+{
+	std::vector<Material> materials;
+	std::vector<MaterialPair> pairs;
+	MaterialMixFunction mixFunction;
+
+	// Custom coefficients for specific pairs. They override mix function
+	struct PairOverride
+	{
+		MaterialId a, b;
+		MaterialPair pair;
+	};
+	std::vector<PairOverride> overrides;
+
+	void rebuild();
+public:
+	// Default mixing: maximum of elasticities and average of frictions
+	static MaterialPair mixDefault(const Material& a, const Material& b);
+
+	// Default material is registered at index 0
+	MaterialTable();
+
+	MaterialId addMaterial(const Material& material);
+	void setMaterial(MaterialId id, const Material& material);
+	const Material& getMaterial(MaterialId id) const;
+	size_t getCountOfMaterials() const;
+	bool isValid(MaterialId id) const;
+
+	void setMixFunction(const MaterialMixFunction& function);
+	void setPair(MaterialId a, MaterialId b, const MaterialPair& pair);
+
+	inline const MaterialPair& getPair(MaterialId a, MaterialId b) const
+	{
+		return pairs[a * materials.size() + b];
+	}
+};
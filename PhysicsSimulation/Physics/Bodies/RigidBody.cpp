@@ -1,12 +1,44 @@
 #include "RigidBody.h"
 #include "Core/CoreMath.h"
 
-RigidBody::RigidBody(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, ShapeType shapeType) :
-	position(pos), velocity(vel), rotation(rot), angularVelocity(angVel), mass(mass), inertia(inertia), localCenterOfMass(), material(material), shapeType(shapeType),
-	aabb(), transformUpdateRequired(true), aabbUpdateRequired(true)
+size_t BodyStates::size() const
 {
-	invMass = mass == 0.0f ? 0.0f : 1.0f / mass;
-	invInertia = inertia == 0.0f ? 0.0f : 1.0f / inertia;
+	return positions.size();
+}
+
+void BodyStates::resize(size_t count)
+{
+	positions.resize(count);
+	velocities.resize(count);
+	rotations.resize(count);
+	angularVelocities.resize(count);
+	invMasses.resize(count);
+	invInertias.resize(count);
+	awake.resize(count);
+}
+
+void BodyStates::copy(size_t from, size_t to)
+{
+	positions[to] = positions[from];
+	velocities[to] = velocities[from];
+	rotations[to] = rotations[from];
+	angularVelocities[to] = angularVelocities[from];
+	invMasses[to] = invMasses[from];
+	invInertias[to] = invInertias[from];
+	awake[to] = awake[from];
+}
+
+RigidBody::RigidBody(BodyStates& states, unsigned int bodyIndex, const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, ShapeType shapeType) :
+	states(&states), mass(mass), inertia(inertia), localCenterOfMass(), material(material), shapeType(shapeType), handle(), bodyIndex(bodyIndex), constraintHandles(), islandIndex(0), sleepingIsland(),
+	sleepTime(0.0f), sleeping(false), speculativeDistance(0.0f), aabb(), transformUpdateRequired(true), aabbUpdateRequired(true)
+{
+	states.positions[bodyIndex] = pos;
+	states.velocities[bodyIndex] = vel;
+	states.rotations[bodyIndex] = rot;
+	states.angularVelocities[bodyIndex] = angVel;
+	states.invMasses[bodyIndex] = mass == 0.0f ? 0.0f : 1.0f / mass;
+	states.invInertias[bodyIndex] = inertia == 0.0f ? 0.0f : 1.0f / inertia;
+	updateAwakeState();
 }
 
 void RigidBody::applyImpulseAt(const glm::vec2& impulse, const glm::vec2& point)
@@ -16,18 +48,45 @@ void RigidBody::applyImpulseAt(const glm::vec2& impulse, const glm::vec2& point)
 
 	glm::vec2 relative = point - centerOfMass;
 
-	velocity += impulse * invMass;
-	angularVelocity += CoreMath::cross(relative, impulse) * invInertia;
+	setVelocity(getVelocity() + impulse * getInvMass());
+	setAngularVelocity(getAngularVelocity() + CoreMath::cross(relative, impulse) * getInvInertia());
+
+	wakeUp();
 }
 
 bool RigidBody::isStatic() const
 {
-	return invMass == 0.0f;
+	return getInvMass() == 0.0f;
+}
+
+bool RigidBody::isSleeping() const
+{
+	return sleeping;
+}
+
+bool RigidBody::isAwake() const
+{
+	return states->awake[bodyIndex] != 0.0f;
+}
+
+void RigidBody::sleep()
+{
+	sleeping = true;
+	updateAwakeState();
+	setVelocity(glm::vec2(0.0f));
+	setAngularVelocity(0.0f);
+}
+
+void RigidBody::wakeUp()
+{
+	sleeping = false;
+	sleepTime = 0.0f;
+	updateAwakeState();
 }
 
 glm::vec2 RigidBody::getCenterOfMass() const
 {
-	return position + localCenterOfMass;
+	return getPosition() + localCenterOfMass;
 }
 
 const AABB& RigidBody::getAABB() const
@@ -54,19 +113,49 @@ void RigidBody::forceToUpdateAABB() const
 	}
 }
 
+float RigidBody::getSpeculativeDistance() const
+{
+	return speculativeDistance;
+}
+
+void RigidBody::setSpeculativeDistance(float distance)
+{
+	// Current AABB is resized in place. If it's outdated, it's recomputed with new distance later anyway
+	glm::vec2 delta = glm::vec2(distance - speculativeDistance);
+	aabb.min -= delta;
+	aabb.max += delta;
+	speculativeDistance = distance;
+}
+
+bool RigidBody::isTransformUpdateRequired() const
+{
+	return transformUpdateRequired;
+}
+
 void RigidBody::setProperties(const BodyProperties& properties)
 {
 	mass = properties.mass;
-	invMass = properties.mass == 0.0f ? 0.0f : 1.0f / properties.mass;
+	states->invMasses[bodyIndex] = properties.mass == 0.0f ? 0.0f : 1.0f / properties.mass;
 
 	inertia = properties.inertia;
-	invInertia = properties.inertia == 0.0f ? 0.0f : 1.0f / properties.inertia;
+	states->invInertias[bodyIndex] = properties.inertia == 0.0f ? 0.0f : 1.0f / properties.inertia;
 
 	localCenterOfMass = properties.centerOfMass;
+	onCenterOfMassChanged();
+	updateAwakeState();
 }
 
+void RigidBody::markMoved()
+{
+	aabbUpdateRequired = true;
+	transformUpdateRequired = true;
+}
+
+void RigidBody::onCenterOfMassChanged()
+{
+}
 
-Material::Material(float elasticity, float staticFriction, float dynamicFriction)
-	: elasticity(elasticity), staticFriction(staticFriction), dynamicFriction(dynamicFriction)
+void RigidBody::updateAwakeState()
 {
+	states->awake[bodyIndex] = !sleeping && getInvMass() != 0.0f ? 1.0f : 0.0f;
 }
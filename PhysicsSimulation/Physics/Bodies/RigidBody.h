@@ -1,19 +1,25 @@
 #pragma once
 #include "Core/AABB.h"
+#include "Core/FixedVector.h"
+#include "Core/HandleTable.h"
+#include "MaterialTable.h"
+
+#include <vector>
 
 enum class ShapeType : unsigned int
 {
-	Circle, Polygon
+	Circle, Polygon, Compound
 };
 
-struct Material
-{
-	float elasticity = 1.0f;
-	float staticFriction = 0.0f, dynamicFriction = 0.0f;
+// Polygons with more vertices are split into several convex pieces of compound body
+constexpr size_t MAX_POLYGON_VERTICES = 12;
+using PolygonVertices = FixedVector<glm::vec2, MAX_POLYGON_VERTICES>;
 
-	Material() = default;
-	Material(float elasticity, float staticFriction, float dynamicFriction);
-};
+class RigidBody;
+using BodyHandle = Handle<RigidBody>;
+
+struct ConstraintId;
+struct SleepingIsland;
 
 struct BodyProperties
 {
@@ -23,24 +29,99 @@ struct BodyProperties
 	//float area;
 };
 
+// Motion state of all bodies of storage as separate arrays by body index. Integration and solvers stream through arrays, that they need, instead of visiting bodies
+struct BodyStates
+{
+	std::vector<glm::vec2> positions, velocities;
+	std::vector<float> rotations, angularVelocities;
+	std::vector<float> invMasses, invInertias;
+	std::vector<float> awake; // 1 for awake bodies and 0 for others, so integration scales motion by it instead of branching
+
+	size_t size() const;
+	void resize(size_t count);
+
+	// Copies state of one index over another, so last body can take place of removed one
+	void copy(size_t from, size_t to);
+};
+
 class RigidBody
 {
 	virtual void updateAABB() const = 0;
+protected:
+	virtual void onCenterOfMassChanged();
+
+	BodyStates* states; // Owned by storage, motion state of body lives at body index
+
+	void updateAwakeState();
 public:
-	glm::vec2 position, velocity;
-	float rotation, angularVelocity;
-	float mass, invMass;
-	float inertia, invInertia;
+	float mass;
+	float inertia;
 	glm::vec2 localCenterOfMass; // TODO: Maybe add center of mass as an option to constructor
 
-	Material* material;
+	MaterialId material;
 	ShapeType shapeType;
+
+	BodyHandle handle; // Stays the same, while body exists
+	unsigned int bodyIndex; // Position in simulation's list of bodies and in state arrays, changes when other bodies are removed
+	std::vector<Handle<ConstraintId>> constraintHandles; // Constraints attached to body, removed together with it
+	unsigned int islandIndex; // Assigned by island builder every step
+	Handle<SleepingIsland> sleepingIsland; // Bodies, that fell asleep together with this one. Invalid once any of them wakes up
+
+	float sleepTime; // How long body has been slow enough to fall asleep
 protected:
+	bool sleeping;
+
+	float speculativeDistance; // AABB is enlarged by it, so contacts are found before shapes touch
+
 	mutable AABB aabb;
 	mutable bool transformUpdateRequired;
 	mutable bool aabbUpdateRequired;
 public:
-	RigidBody(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, ShapeType shapeType);
+	// Writes motion state into states at bodyIndex, so storage resizes them first
+	RigidBody(BodyStates& states, unsigned int bodyIndex, const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, ShapeType shapeType);
+
+	inline const glm::vec2& getPosition() const
+	{
+		return states->positions[bodyIndex];
+	}
+	inline const glm::vec2& getVelocity() const
+	{
+		return states->velocities[bodyIndex];
+	}
+	inline float getRotation() const
+	{
+		return states->rotations[bodyIndex];
+	}
+	inline float getAngularVelocity() const
+	{
+		return states->angularVelocities[bodyIndex];
+	}
+	inline float getInvMass() const
+	{
+		return states->invMasses[bodyIndex];
+	}
+	inline float getInvInertia() const
+	{
+		return states->invInertias[bodyIndex];
+	}
+
+	// Doesn't refresh transform and AABB, move() and rotate() do
+	inline void setPosition(const glm::vec2& pos)
+	{
+		states->positions[bodyIndex] = pos;
+	}
+	inline void setVelocity(const glm::vec2& vel)
+	{
+		states->velocities[bodyIndex] = vel;
+	}
+	inline void setRotation(float rot)
+	{
+		states->rotations[bodyIndex] = rot;
+	}
+	inline void setAngularVelocity(float angVel)
+	{
+		states->angularVelocities[bodyIndex] = angVel;
+	}
 
 	virtual void move(const glm::vec2& shift) = 0;
 	virtual void rotate(float angle) = 0;
@@ -49,12 +130,26 @@ public:
 	void applyImpulseAt(const glm::vec2& impulse, const glm::vec2& point);
 
 	bool isStatic() const;
+
+	// Sleeping bodies aren't integrated and are collision tested only against awake ones
+	bool isSleeping() const;
+	bool isAwake() const; // Dynamic and not sleeping
+	void sleep();
+	void wakeUp();
 	glm::vec2 getCenterOfMass() const;
 
 	const AABB& getAABB() const;
 	const AABB& getAABB_noUpdate() const;
 	void forceToUpdateAABB() const;
 
+	float getSpeculativeDistance() const;
+	void setSpeculativeDistance(float distance);
+
+	bool isTransformUpdateRequired() const;
+
+	// State arrays moved body directly, so its transform and AABB are refreshed by storage
+	void markMoved();
+
 	virtual BodyProperties calculateProperties(float density) const = 0;
 	void setProperties(const BodyProperties& properties);
 };
\ No newline at end of file
@@ -5,35 +5,35 @@
 
 void RigidCircle::updateAABB() const
 {
-	glm::vec2 dpos = glm::vec2(radius);
-	aabb.min = position - dpos;
-	aabb.max = position + dpos;
+	glm::vec2 dpos = glm::vec2(radius + speculativeDistance);
+	aabb.min = getPosition() - dpos;
+	aabb.max = getPosition() + dpos;
 }
 
-RigidCircle::RigidCircle(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, float radius)
-	: RigidBody(pos, vel, rot, angVel, mass, inertia, material, ShapeType::Circle), radius(radius)
+RigidCircle::RigidCircle(BodyStates& states, unsigned int bodyIndex, const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, float radius)
+	: RigidBody(states, bodyIndex, pos, vel, rot, angVel, mass, inertia, material, ShapeType::Circle), radius(radius)
 {
 }
 
 void RigidCircle::move(const glm::vec2& shift)
 {
-	position += shift;
+	setPosition(getPosition() + shift);
 	aabb.min += shift;
 	aabb.max += shift;
 }
 
 void RigidCircle::rotate(float angle)
 {
-	rotation += angle;
+	setRotation(getRotation() + angle);
 }
 
 void RigidCircle::moveAndRotate(const glm::vec2& shift, float angle)
 {
-	position += shift;
+	setPosition(getPosition() + shift);
 	aabb.min += shift;
 	aabb.max += shift;
 
-	rotation += angle;
+	setRotation(getRotation() + angle);
 }
 
 BodyProperties RigidCircle::calculateProperties(float density) const
@@ -7,7 +7,7 @@ class RigidCircle : public RigidBody
 public:
 	float radius;
 
-	RigidCircle(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, float radius);
+	RigidCircle(BodyStates& states, unsigned int bodyIndex, const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, float radius);
 
 	void move(const glm::vec2& shift) override;
 	void rotate(float angle) override;
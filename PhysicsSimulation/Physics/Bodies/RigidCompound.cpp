@@ -0,0 +1,263 @@
+#include "RigidCompound.h"
+#include "RigidPolygon.h"
+
+#include "Core/CoreMath.h"
+#include "Core/SimdMath.h"
+#include "Core/ConvexDecomposition.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+CompoundShape CompoundShape::circle(const glm::vec2& offset, float radius)
+{
+	CompoundShape shape;
+	shape.shapeType = ShapeType::Circle;
+	shape.offset = offset;
+	shape.radius = radius;
+	return shape;
+}
+
+CompoundShape CompoundShape::box(const glm::vec2& offset, const glm::vec2& size, float rotation)
+{
+	float w = size.x * 0.5f;
+	float h = size.y * 0.5f;
+
+	return polygon(offset, { {-w, h}, {w, h}, {w, -h}, {-w, -h} }, rotation);
+}
+
+CompoundShape CompoundShape::polygon(const glm::vec2& offset, const std::vector<glm::vec2>& vertices, float rotation)
+{
+	CompoundShape shape;
+	shape.shapeType = ShapeType::Polygon;
+	shape.offset = offset;
+	shape.rotation = rotation;
+	shape.vertices = vertices;
+	return shape;
+}
+
+void RigidCompound::updateAABB() const
+{
+	// AABB is computed along with transformed children
+	updateTransform({ cosf(getRotation()), sinf(getRotation()) });
+}
+
+void RigidCompound::addChild(const CompoundShape& shape)
+{
+	if (shape.shapeType == ShapeType::Circle)
+	{
+		CompoundChild child;
+		child.shapeType = ShapeType::Circle;
+		child.center = shape.offset;
+		child.radius = shape.radius;
+		children.push_back(child);
+		return;
+	}
+
+	// Concave and too big polygons are split, so every child stays convex and fits into inline storage
+	std::vector<std::vector<glm::vec2>> pieces;
+	if (shape.vertices.size() <= MAX_POLYGON_VERTICES && ConvexDecomposition::isConvex(shape.vertices))
+	{
+		pieces.push_back(shape.vertices);
+	}
+	else
+	{
+		pieces = ConvexDecomposition::decompose(shape.vertices, MAX_POLYGON_VERTICES);
+	}
+
+	for (auto& piece : pieces)
+	{
+		CompoundChild child;
+		child.shapeType = ShapeType::Polygon;
+		child.radius = 0.0f;
+		child.center = {};
+		for (auto& vert : piece)
+		{
+			vert = CoreMath::rotatePoint(vert, shape.rotation) + shape.offset;
+			child.center += vert;
+		}
+		child.center /= (float)piece.size();
+		for (const auto& vert : piece)
+		{
+			child.radius = fmaxf(child.radius, glm::length(vert - child.center));
+		}
+		child.vertices.assign(piece.data(), piece.size());
+		child.transformedVertices.resize(child.vertices.size());
+		children.push_back(std::move(child));
+	}
+}
+
+RigidCompound::RigidCompound(BodyStates& states, unsigned int bodyIndex, const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<CompoundShape>& shapes)
+	: RigidBody(states, bodyIndex, pos, vel, rot, angVel, mass, inertia, material, ShapeType::Compound)
+{
+	children.reserve(shapes.size());
+	for (const auto& shape : shapes)
+	{
+		addChild(shape);
+	}
+
+	// Children never move relative to the body, so the tree is built once in body space
+	std::vector<AABB> localBounds;
+	localBounds.reserve(children.size());
+	for (const auto& child : children)
+	{
+		if (child.shapeType == ShapeType::Circle)
+		{
+			localBounds.emplace_back(child.center - child.radius, child.center + child.radius);
+			continue;
+		}
+
+		AABB bounds = { child.vertices[0], child.vertices[0] };
+		for (const auto& vert : child.vertices)
+		{
+			bounds.min = glm::min(bounds.min, vert);
+			bounds.max = glm::max(bounds.max, vert);
+		}
+		localBounds.push_back(bounds);
+	}
+	childTree.build(localBounds);
+}
+
+void RigidCompound::updateTransform(const glm::vec2& cosSin) const
+{
+	glm::vec2 rotatedCenterOfMass =
+	{
+		localCenterOfMass.x * cosSin.x - localCenterOfMass.y * cosSin.y,
+		localCenterOfMass.x * cosSin.y + localCenterOfMass.y * cosSin.x
+	};
+	glm::vec2 translation = getPosition() + localCenterOfMass - rotatedCenterOfMass;
+
+	AABB bounds = { glm::vec2(FLT_MAX), glm::vec2(-FLT_MAX) };
+	for (const auto& child : children)
+	{
+		SimdMath::transformPoints(&child.center, &child.transformedCenter, 1, cosSin, translation);
+
+		if (child.shapeType == ShapeType::Circle)
+		{
+			glm::vec2 dpos = glm::vec2(child.radius);
+			child.aabb.min = child.transformedCenter - dpos;
+			child.aabb.max = child.transformedCenter + dpos;
+		}
+		else
+		{
+			child.aabb = SimdMath::transformPoints(child.vertices.data(), child.transformedVertices.data(), child.vertices.size(), cosSin, translation);
+		}
+		child.aabb.min -= glm::vec2(speculativeDistance);
+		child.aabb.max += glm::vec2(speculativeDistance);
+
+		bounds.min = glm::min(bounds.min, child.aabb.min);
+		bounds.max = glm::max(bounds.max, child.aabb.max);
+	}
+	aabb = bounds;
+
+	transformUpdateRequired = false;
+	aabbUpdateRequired = false;
+}
+
+void RigidCompound::move(const glm::vec2& shift)
+{
+	setPosition(getPosition() + shift);
+	aabbUpdateRequired = true;
+	transformUpdateRequired = true;
+}
+
+void RigidCompound::rotate(float angle)
+{
+	setRotation(getRotation() + angle);
+	aabbUpdateRequired = true;
+	transformUpdateRequired = true;
+}
+
+void RigidCompound::moveAndRotate(const glm::vec2& shift, float angle)
+{
+	setPosition(getPosition() + shift);
+	setRotation(getRotation() + angle);
+	aabbUpdateRequired = true;
+	transformUpdateRequired = true;
+}
+
+BodyProperties RigidCompound::calculateProperties(float density) const
+{
+	BodyProperties properties;
+
+	std::vector<BodyProperties> childrenProperties;
+	childrenProperties.reserve(children.size());
+
+	float mass = 0.0f;
+	glm::vec2 centerOfMass = {};
+	for (const auto& child : children)
+	{
+		BodyProperties childProperties;
+		if (child.shapeType == ShapeType::Circle)
+		{
+			float area = (float)M_PI * child.radius * child.radius;
+			childProperties.mass = area * density;
+			childProperties.inertia = 0.5f * childProperties.mass * child.radius * child.radius;
+			childProperties.centerOfMass = child.center;
+		}
+		else
+		{
+			childProperties = RigidPolygon::calculatePolygonProperties(child.vertices.data(), child.vertices.size(), density);
+		}
+
+		mass += childProperties.mass;
+		centerOfMass += childProperties.centerOfMass * childProperties.mass;
+		childrenProperties.push_back(childProperties);
+	}
+	centerOfMass /= mass;
+
+	// Parallel axis theorem
+	float inertia = 0.0f;
+	for (const auto& childProperties : childrenProperties)
+	{
+		glm::vec2 offset = childProperties.centerOfMass - centerOfMass;
+		inertia += childProperties.inertia + childProperties.mass * glm::dot(offset, offset);
+	}
+
+	properties.mass = mass;
+	properties.inertia = inertia;
+	properties.centerOfMass = centerOfMass;
+	return properties;
+}
+
+const std::vector<CompoundChild>& RigidCompound::getChildren() const
+{
+	if (transformUpdateRequired)
+	{
+		updateTransform({ cosf(getRotation()), sinf(getRotation()) });
+	}
+	return children;
+}
+
+void RigidCompound::queryChildren(const AABB& searchAABB, std::vector<int>& outChildren) const
+{
+	const auto& children = getChildren();
+
+	// Bring search box into body space. Rotated box is wrapped into AABB, so the tree may return a few extra children
+	glm::vec2 pivot = getPosition() + localCenterOfMass;
+	glm::vec2 corners[4] =
+	{
+		searchAABB.min, { searchAABB.min.x, searchAABB.max.y }, searchAABB.max, { searchAABB.max.x, searchAABB.min.y }
+	};
+
+	AABB localSearch = { glm::vec2(FLT_MAX), glm::vec2(-FLT_MAX) };
+	for (const auto& corner : corners)
+	{
+		glm::vec2 local = CoreMath::rotatePoint(corner - pivot, -getRotation()) + localCenterOfMass;
+		localSearch.min = glm::min(localSearch.min, local);
+		localSearch.max = glm::max(localSearch.max, local);
+	}
+
+	size_t begin = outChildren.size();
+	childTree.query(localSearch, outChildren);
+
+	// Keep only children, that really overlap in world space
+	size_t end = begin;
+	for (size_t i = begin; i < outChildren.size(); i++)
+	{
+		if (children[outChildren[i]].aabb.isIntersecting(searchAABB))
+		{
+			outChildren[end++] = outChildren[i];
+		}
+	}
+	outChildren.resize(end);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "RigidBody.h"
+#include "Physics/Spatial/AABBTree.h"
+#include <vector>
+
+// Description of one child shape, placed at local offset of the compound body
+struct CompoundShape
+{
+	ShapeType shapeType = ShapeType::Circle;
+	glm::vec2 offset = {};
+	float rotation = 0.0f;
+	float radius = 0.0f; // Circle
+	std::vector<glm::vec2> vertices; // Polygon, relative to offset
+
+	static CompoundShape circle(const glm::vec2& offset, float radius);
+	static CompoundShape box(const glm::vec2& offset, const glm::vec2& size, float rotation = 0.0f);
+	static CompoundShape polygon(const glm::vec2& offset, const std::vector<glm::vec2>& vertices, float rotation = 0.0f);
+};
+
+struct CompoundChild
+{
+	ShapeType shapeType; // Circle or convex Polygon
+
+	// Body space
+	glm::vec2 center;
+	float radius; // Bounding radius around center for polygons
+	PolygonVertices vertices;
+
+	// World space
+	mutable glm::vec2 transformedCenter;
+	mutable PolygonVertices transformedVertices;
+	mutable AABB aabb;
+};
+
+// Body made of several circles and convex polygons, that move as one rigid body
+class RigidCompound : public RigidBody
+{
+	void updateAABB() const override;
+
+	std::vector<CompoundChild> children;
+	AABBTree childTree; // Over body space AABBs of children
+
+	void addChild(const CompoundShape& shape);
+public:
+	RigidCompound(BodyStates& states, unsigned int bodyIndex, const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<CompoundShape>& shapes);
+
+	void move(const glm::vec2& shift) override;
+	void rotate(float angle) override;
+	void moveAndRotate(const glm::vec2& shift, float angle) override;
+
+	// Transforms children and refreshes AABBs. cosSin is (cos(rotation), sin(rotation)), so it can be computed in batch
+	void updateTransform(const glm::vec2& cosSin) const;
+
+	BodyProperties calculateProperties(float density) const override;
+
+	// Children with up-to-date transformed vertices and AABBs
+	const std::vector<CompoundChild>& getChildren() const;
+
+	// Indices of children, whose world AABB intersects searchAABB
+	void queryChildren(const AABB& searchAABB, std::vector<int>& outChildren) const;
+};
@@ -1,87 +1,82 @@
 #include "RigidPolygon.h"
 
-#include "Core/Transform.h"
 #include "Core/CoreMath.h"
+#include "Core/SimdMath.h"
 
-#include <iostream>
-
-void RigidPolygon::updateTransformedVertices() const
-{
-	Transform transform(position, rotation);
+#include <math.h>
 
-	size_t count = vertices.size();
-	for (size_t i = 0; i < count; i++)
-	{
-		transformedVertices[i] = transform.transform(vertices[i] - localCenterOfMass) + localCenterOfMass;
-	}
-}
+#include <iostream>
 
 void RigidPolygon::updateAABB() const
 {
-	float minX = FLT_MAX, minY = FLT_MAX;
-	float maxX = -FLT_MAX, maxY = -FLT_MAX;
-
-	const auto& verts = getTransformedVertices();
-	for (const auto& vert : verts)
-	{
-		minX = fminf(minX, vert.x);
-		minY = fminf(minY, vert.y);
-
-		maxX = fmaxf(maxX, vert.x);
-		maxY = fmaxf(maxY, vert.y);
-	}
-
-	aabb.min = { minX, minY };
-	aabb.max = { maxX, maxY };
+	// AABB is computed along with transformed vertices
+	updateTransform({ cosf(getRotation()), sinf(getRotation()) });
 }
 
-RigidPolygon::RigidPolygon(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, const std::vector<glm::vec2>& verts)
-	: RigidBody(pos, vel, rot, angVel, mass, inertia, material, ShapeType::Polygon), vertices(verts)
+RigidPolygon::RigidPolygon(BodyStates& states, unsigned int bodyIndex, const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<glm::vec2>& verts)
+	: RigidBody(states, bodyIndex, pos, vel, rot, angVel, mass, inertia, material, ShapeType::Polygon), vertices(verts)
 {
 	transformedVertices.resize(vertices.size());
+	onCenterOfMassChanged();
 }
 
-RigidPolygon::RigidPolygon(RigidPolygon&& other) noexcept
-	: RigidBody(std::move(other)),
-	vertices(std::move(other.vertices)),
-	transformedVertices(std::move(other.transformedVertices))
+void RigidPolygon::onCenterOfMassChanged()
 {
+	float maxDistanceSquared = 0.0f;
+	for (const auto& vert : vertices)
+	{
+		glm::vec2 dpos = vert - localCenterOfMass;
+		maxDistanceSquared = fmaxf(maxDistanceSquared, glm::dot(dpos, dpos));
+	}
+	boundingRadius = sqrtf(maxDistanceSquared);
 }
 
-RigidPolygon& RigidPolygon::operator=(RigidPolygon&& other) noexcept
+void RigidPolygon::updateTransform(const glm::vec2& cosSin) const
 {
-	if (this != &other)
+	// Rotation is around center of mass: rotate(v - com) + com + position = rotate(v) + translation
+	glm::vec2 rotatedCenterOfMass =
 	{
-		RigidBody::operator=(std::move(dynamic_cast<RigidBody&&>(other)));
-		vertices = std::move(other.vertices);
-		transformedVertices = std::move(other.transformedVertices);
-	}
-	return *this;
+		localCenterOfMass.x * cosSin.x - localCenterOfMass.y * cosSin.y,
+		localCenterOfMass.x * cosSin.y + localCenterOfMass.y * cosSin.x
+	};
+	glm::vec2 translation = getPosition() + localCenterOfMass - rotatedCenterOfMass;
+
+	aabb = SimdMath::transformPoints(vertices.data(), transformedVertices.data(), vertices.size(), cosSin, translation);
+	aabb.min -= glm::vec2(speculativeDistance);
+	aabb.max += glm::vec2(speculativeDistance);
+
+	transformUpdateRequired = false;
+	aabbUpdateRequired = false;
 }
 
 void RigidPolygon::move(const glm::vec2& shift)
 {
-	position += shift;
+	setPosition(getPosition() + shift);
 	aabbUpdateRequired = true;
 	transformUpdateRequired = true;
 }
 
 void RigidPolygon::rotate(float angle)
 {
-	rotation += angle;
+	setRotation(getRotation() + angle);
 	aabbUpdateRequired = true;
 	transformUpdateRequired = true;
 }
 
 void RigidPolygon::moveAndRotate(const glm::vec2& shift, float angle)
 {
-	position += shift;
-	rotation += angle;
+	setPosition(getPosition() + shift);
+	setRotation(getRotation() + angle);
 	aabbUpdateRequired = true;
 	transformUpdateRequired = true;
 }
 
 BodyProperties RigidPolygon::calculateProperties(float density) const
+{
+	return calculatePolygonProperties(vertices.data(), vertices.size(), density);
+}
+
+BodyProperties RigidPolygon::calculatePolygonProperties(const glm::vec2* vertices, size_t verticesCount, float density)
 {
 	BodyProperties properties;
 
@@ -91,7 +86,7 @@ BodyProperties RigidPolygon::calculateProperties(float density) const
 
 	{
 		// Area and centroid
-		size_t n = vertices.size();
+		size_t n = verticesCount;
 		for (size_t i = 0; i < n; i++)
 		{
 			const glm::vec2& a = vertices[i];
@@ -100,8 +95,8 @@ BodyProperties RigidPolygon::calculateProperties(float density) const
 			area += cross;
 			centerOfMass += (a + b) * cross;
 		}
+		centerOfMass /= 3.0f * area;
 		area = fabsf(area) * 0.5f;
-		centerOfMass /= 6.0f * area;
 
 		// Moment of inertia
 		for (size_t i = 0; i < n; i++)
@@ -121,17 +116,21 @@ BodyProperties RigidPolygon::calculateProperties(float density) const
 	return properties;
 }
 
-const std::vector<glm::vec2>& RigidPolygon::getVertices() const
+const PolygonVertices& RigidPolygon::getVertices() const
 {
 	return vertices;
 }
 
-const std::vector<glm::vec2>& RigidPolygon::getTransformedVertices() const
+float RigidPolygon::getBoundingRadius() const
+{
+	return boundingRadius;
+}
+
+const PolygonVertices& RigidPolygon::getTransformedVertices() const
 {
 	if (transformUpdateRequired)
 	{
-		transformUpdateRequired = false;
-		updateTransformedVertices();
+		updateTransform({ cosf(getRotation()), sinf(getRotation()) });
 	}
 	return transformedVertices;
 }
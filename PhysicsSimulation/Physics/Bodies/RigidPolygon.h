@@ -4,24 +4,31 @@
 
 class RigidPolygon : public RigidBody
 {
-	void updateTransformedVertices() const;
 	void updateAABB() const override;
+	void onCenterOfMassChanged() override;
 
-	std::vector<glm::vec2> vertices;
-	mutable std::vector<glm::vec2> transformedVertices;
+	PolygonVertices vertices;
+	mutable PolygonVertices transformedVertices;
+
+	float boundingRadius; // Around center of mass
 public:
 
-	RigidPolygon(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, const std::vector<glm::vec2>& verts);
-	RigidPolygon(RigidPolygon&& other) noexcept;
-	RigidPolygon& operator=(RigidPolygon&& other) noexcept;
+	RigidPolygon(BodyStates& states, unsigned int bodyIndex, const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<glm::vec2>& verts);
+	RigidPolygon(RigidPolygon&& other) noexcept = default;
+	RigidPolygon& operator=(RigidPolygon&& other) noexcept = default;
 
 	void move(const glm::vec2& shift) override;
 	void rotate(float angle) override;
 	void moveAndRotate(const glm::vec2& shift, float angle) override;
 
+	// Transforms vertices and refreshes AABB. cosSin is (cos(rotation), sin(rotation)), so it can be computed in batch
+	void updateTransform(const glm::vec2& cosSin) const;
+
 	BodyProperties calculateProperties(float density) const override;
+	static BodyProperties calculatePolygonProperties(const glm::vec2* vertices, size_t verticesCount, float density);
 
-	const std::vector<glm::vec2>& getVertices() const;
-	const std::vector<glm::vec2>& getTransformedVertices() const;
+	const PolygonVertices& getVertices() const;
+	const PolygonVertices& getTransformedVertices() const;
+	float getBoundingRadius() const;
 };
 
@@ -9,9 +9,12 @@ const Collisions::CheckCollisionFunction Collisions::checkCollisionFunctionsMatr
 	{ nullptr,                  Collisions::polygonPolygon }  // Polygon
 };
 
+// Edge of B becomes reference only if it is clearly better than edge of A. Otherwise nearly flat contacts keep switching sides, and contacts lose their cached impulses
+constexpr float REFERENCE_FACE_TOLERANCE = 0.0005f;
+
 std::vector<CollisionManifold> Collisions::manifolds;
 
-glm::vec2 Collisions::projectVertices(const std::vector<glm::vec2>& vertices, glm::vec2 axis)
+glm::vec2 Collisions::projectVertices(const PolygonVertices& vertices, glm::vec2 axis)
 {
 	float min = FLT_MAX;
 	float max = -FLT_MAX;
@@ -38,7 +41,7 @@ glm::vec2 Collisions::projectCircle(const glm::vec2& position, float radius, glm
 	return { proj - radius, proj + radius };
 }
 
-glm::vec2 Collisions::findClosestVertexOnPolygon(const glm::vec2& point, const std::vector<glm::vec2>& vertices)
+glm::vec2 Collisions::findClosestVertexOnPolygon(const glm::vec2& point, const PolygonVertices& vertices)
 {
 	glm::vec2 closestPoint = {};
 	float minDistSquared = FLT_MAX;
@@ -85,16 +88,85 @@ glm::vec2 Collisions::findClosestPointOnSegment(const glm::vec2& start, const gl
 	return contact;
 }
 
-bool Collisions::circleCircle(CollisionManifold& result, const RigidBody* bodyA, const RigidBody* bodyB)
+unsigned int Collisions::makeFeatureId(unsigned int side, size_t vertexIndex, size_t edgeIndex)
+{
+	// Vertex of one shape against edge of the other. Stays the same while shapes touch the same way
+	return (side << 16) | ((unsigned int)vertexIndex << 8) | (unsigned int)edgeIndex;
+}
+
+void Collisions::findSupportEdge(const PolygonVertices& vertices, const glm::vec2& direction, size_t outVertices[2])
+{
+	const size_t verticesCount = vertices.size();
+
+	// Vertex, that is the furthest along direction
+	size_t supportVertex = 0;
+	float maxProjection = -FLT_MAX;
+	for (size_t i = 0; i < verticesCount; i++)
+	{
+		float projection = glm::dot(vertices[i], direction);
+		if (projection > maxProjection)
+		{
+			maxProjection = projection;
+			supportVertex = i;
+		}
+	}
+
+	// Of two edges next to it, the one that is closer to be perpendicular to direction
+	size_t previousVertex = (supportVertex + verticesCount - 1) % verticesCount;
+	size_t nextVertex = (supportVertex + 1) % verticesCount;
+	glm::vec2 toPrevious = glm::normalize(vertices[previousVertex] - vertices[supportVertex]);
+	glm::vec2 toNext = glm::normalize(vertices[nextVertex] - vertices[supportVertex]);
+
+	if (fabsf(glm::dot(toPrevious, direction)) < fabsf(glm::dot(toNext, direction)))
+	{
+		outVertices[0] = previousVertex;
+		outVertices[1] = supportVertex;
+	}
+	else
+	{
+		outVertices[0] = supportVertex;
+		outVertices[1] = nextVertex;
+	}
+}
+
+void Collisions::clipSegment(glm::vec2 points[2], const glm::vec2& planeNormal, float planeOffset)
+{
+	// Keeps part of segment, where dot(planeNormal, point) >= planeOffset
+	float distance1 = glm::dot(planeNormal, points[0]) - planeOffset;
+	float distance2 = glm::dot(planeNormal, points[1]) - planeOffset;
+	if ((distance1 >= 0.0f) == (distance2 >= 0.0f))
+	{
+		// Nothing to clip, or whole segment is outside, which only happens because of precision
+		return;
+	}
+
+	glm::vec2 intersection = points[0] + (points[1] - points[0]) * (distance1 / (distance1 - distance2));
+	if (distance1 < 0.0f)
+	{
+		points[0] = intersection;
+	}
+	else
+	{
+		points[1] = intersection;
+	}
+}
+
+bool Collisions::areBoundingCirclesIntersecting(const ConvexShape& shapeA, const ConvexShape& shapeB, float speculativeDistance)
 {
-	const RigidCircle* circleA = dynamic_cast<const RigidCircle*>(bodyA);
-	const RigidCircle* circleB = dynamic_cast<const RigidCircle*>(bodyB);
+	// Rotated polygons often have overlapping AABBs, while being far apart. This is much cheaper than SAT
+	glm::vec2 deltaPos = shapeB.center - shapeA.center;
+	float radiusSum = shapeA.radius + shapeB.radius + speculativeDistance;
+	return glm::dot(deltaPos, deltaPos) < radiusSum * radiusSum;
+}
 
-	glm::vec2 deltaPos = circleB->position - circleA->position;
+bool Collisions::circleCircle(CollisionManifold& result, const ConvexShape& circleA, const ConvexShape& circleB, float speculativeDistance)
+{
+	glm::vec2 deltaPos = circleB.center - circleA.center;
 	float distanceSquared = glm::dot(deltaPos, deltaPos);
 
-	float radiusSum = circleA->radius + circleB->radius;
-	if (distanceSquared >= radiusSum * radiusSum)
+	float radiusSum = circleA.radius + circleB.radius;
+	float maxDistance = radiusSum + speculativeDistance;
+	if (distanceSquared >= maxDistance * maxDistance)
 	{
 		return false;
 	}
@@ -114,21 +186,26 @@ bool Collisions::circleCircle(CollisionManifold& result, const RigidBody* bodyA,
 
 	result.normal = normal;
 	result.depth = depth;
-	result.contacts[0] = circleA->position + normal * circleA->radius;
+	result.contacts[0] = circleA.center + normal * circleA.radius;
+	result.separations[0] = -depth;
+	result.featureIds[0] = 0;
 	result.countOfContacts = 1;
 	return true;
 }
 
-bool Collisions::polygonPolygon(CollisionManifold& result, const RigidBody* bodyA, const RigidBody* bodyB)
+bool Collisions::polygonPolygon(CollisionManifold& result, const ConvexShape& polygonA, const ConvexShape& polygonB, float speculativeDistance)
 {
-	const RigidPolygon* polygonA = dynamic_cast<const RigidPolygon*>(bodyA);
-	const RigidPolygon* polygonB = dynamic_cast<const RigidPolygon*>(bodyB);
+	if (!areBoundingCirclesIntersecting(polygonA, polygonB, speculativeDistance))
+	{
+		return false;
+	}
 
 	glm::vec2 normal = {};
 	float depth = FLT_MAX;
+	bool isReferenceOnA = true;
 
-	const auto& verticesA = polygonA->getTransformedVertices();
-	const auto& verticesB = polygonB->getTransformedVertices();
+	const auto& verticesA = *polygonA.vertices;
+	const auto& verticesB = *polygonB.vertices;
 
 	const size_t verticesCountA = verticesA.size();
 	const size_t verticesCountB = verticesB.size();
@@ -147,7 +224,7 @@ bool Collisions::polygonPolygon(CollisionManifold& result, const RigidBody* body
 			glm::vec2 rangeA = projectVertices(verticesA, axis);
 			glm::vec2 rangeB = projectVertices(verticesB, axis);
 
-			if (rangeA.x >= rangeB.y || rangeB.x >= rangeA.y)
+			if (rangeA.x >= rangeB.y + speculativeDistance || rangeB.x >= rangeA.y + speculativeDistance)
 			{
 				return false;
 			}
@@ -160,6 +237,7 @@ bool Collisions::polygonPolygon(CollisionManifold& result, const RigidBody* body
 				depth = axisDepth;
 				normal = axis;
 				collisionSide = bmax_amin < amax_bmin;
+				isReferenceOnA = true;
 			}
 		}
 
@@ -174,7 +252,7 @@ bool Collisions::polygonPolygon(CollisionManifold& result, const RigidBody* body
 			glm::vec2 rangeA = projectVertices(verticesA, axis);
 			glm::vec2 rangeB = projectVertices(verticesB, axis);
 
-			if (rangeA.x >= rangeB.y || rangeB.x >= rangeA.y)
+			if (rangeA.x >= rangeB.y + speculativeDistance || rangeB.x >= rangeA.y + speculativeDistance)
 			{
 				return false;
 			}
@@ -182,11 +260,12 @@ bool Collisions::polygonPolygon(CollisionManifold& result, const RigidBody* body
 			float bmax_amin = rangeB.y - rangeA.x;
 			float amax_bmin = rangeA.y - rangeB.x;
 			float axisDepth = fminf(bmax_amin, amax_bmin);
-			if (axisDepth < depth)
+			if (axisDepth < depth - REFERENCE_FACE_TOLERANCE)
 			{
 				depth = axisDepth;
 				normal = axis;
 				collisionSide = bmax_amin < amax_bmin;
+				isReferenceOnA = false;
 			}
 		}
 
@@ -196,88 +275,65 @@ bool Collisions::polygonPolygon(CollisionManifold& result, const RigidBody* body
 		}
 	}
 
-	// Find contact points
-	glm::vec2 contact1, contact2;
-	unsigned int countOfContacts = 1;
-	{
-		float minDistanceSquared = FLT_MAX;
-		for (size_t i = 0; i < verticesCountA; i++)
-		{
-			glm::vec2 p = verticesA[i];
+	// Find contact points by clipping incident edge against reference edge, so resting faces keep both points even when slightly tilted
+	const PolygonVertices& reference = isReferenceOnA ? verticesA : verticesB;
+	const PolygonVertices& incident = isReferenceOnA ? verticesB : verticesA;
+	const glm::vec2 referenceNormal = isReferenceOnA ? normal : -normal; // Points from reference towards incident shape
 
-			for (size_t j = 0; j < verticesCountB; j++)
-			{
-				glm::vec2 va = verticesB[j];
-				glm::vec2 vb = verticesB[(j + 1) % verticesCountB];
-			
-				float distanceSquared;
-				glm::vec2 contact = findClosestPointOnSegment(va, vb, p, distanceSquared);
-
-				if (fabsf(distanceSquared - minDistanceSquared) < 1e-6f)
-				{
-					glm::vec2 diff = contact - contact2;
-					if (glm::dot(diff, diff) > 1e-16f)
-					{
-						contact2 = contact;
-						countOfContacts = 2;
-					}
-				}
-				else if (distanceSquared < minDistanceSquared)
-				{
-					minDistanceSquared = distanceSquared;
-					contact1 = contact;
-					countOfContacts = 1;
-				}
-			}
-		}
-		for (size_t i = 0; i < verticesCountB; i++)
-		{
-			glm::vec2 p = verticesB[i];
+	size_t referenceVertices[2], incidentVertices[2];
+	findSupportEdge(reference, referenceNormal, referenceVertices);
+	findSupportEdge(incident, -referenceNormal, incidentVertices);
+	const size_t referenceEdge = referenceVertices[0];
 
-			for (size_t j = 0; j < verticesCountA; j++)
-			{
-				glm::vec2 va = verticesA[j];
-				glm::vec2 vb = verticesA[(j + 1) % verticesCountA];
+	const glm::vec2 reference1 = reference[referenceVertices[0]];
+	const glm::vec2 reference2 = reference[referenceVertices[1]];
 
-				float distanceSquared;
-				glm::vec2 contact = findClosestPointOnSegment(va, vb, p, distanceSquared);
+	glm::vec2 points[2] = { incident[incidentVertices[0]], incident[incidentVertices[1]] };
+	glm::vec2 referenceTangent = glm::normalize(reference2 - reference1);
+	clipSegment(points, referenceTangent, glm::dot(referenceTangent, reference1));
+	clipSegment(points, -referenceTangent, -glm::dot(referenceTangent, reference2));
 
-				if (fabsf(distanceSquared - minDistanceSquared) < 1e-6f)
-				{
-					glm::vec2 diff = contact - contact2;
-					if (glm::dot(diff, diff) > 1e-16f)
-					{
-						contact2 = contact;
-						countOfContacts = 2;
-					}
-				}
-				else if (distanceSquared < minDistanceSquared)
-				{
-					minDistanceSquared = distanceSquared;
-					contact1 = contact;
-					countOfContacts = 1;
-				}
-			}
+	unsigned int countOfContacts = 0;
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		float separation = glm::dot(points[i] - reference1, referenceNormal);
+		if (separation > speculativeDistance)
+		{
+			continue;
 		}
+
+		result.contacts[countOfContacts] = points[i];
+		result.separations[countOfContacts] = separation;
+		result.featureIds[countOfContacts] = makeFeatureId(isReferenceOnA ? 1 : 0, incidentVertices[i], referenceEdge);
+		countOfContacts++;
+	}
+
+	if (countOfContacts == 0)
+	{
+		// Clipping lost both points because of precision
+		result.contacts[0] = incident[incidentVertices[0]];
+		result.separations[0] = -depth;
+		result.featureIds[0] = makeFeatureId(isReferenceOnA ? 1 : 0, incidentVertices[0], referenceEdge);
+		countOfContacts = 1;
 	}
 
 	result.normal = normal;
 	result.depth = depth;
-	result.contacts[0] = contact1;
-	result.contacts[1] = contact2;
 	result.countOfContacts = countOfContacts;
 	return true;
 }
 
-bool Collisions::circlePolygon(CollisionManifold& result, const RigidBody* bodyA, const RigidBody* bodyB)
+bool Collisions::circlePolygon(CollisionManifold& result, const ConvexShape& circleA, const ConvexShape& polygonB, float speculativeDistance)
 {
-	const RigidCircle* circleA = dynamic_cast<const RigidCircle*>(bodyA);
-	const RigidPolygon* polygonB = dynamic_cast<const RigidPolygon*>(bodyB);
+	if (!areBoundingCirclesIntersecting(circleA, polygonB, speculativeDistance))
+	{
+		return false;
+	}
 
 	glm::vec2 normal = {};
 	float depth = FLT_MAX;
 
-	const auto& vertices = polygonB->getTransformedVertices();
+	const auto& vertices = *polygonB.vertices;
 	const size_t verticesCount = vertices.size();
 
 	{
@@ -291,9 +347,9 @@ bool Collisions::circlePolygon(CollisionManifold& result, const RigidBody* bodyA
 			glm::vec2 axis = glm::normalize(glm::vec2(-edge.y, edge.x));
 
 			glm::vec2 rangeA = projectVertices(vertices, axis);
-			glm::vec2 rangeB = projectCircle(circleA->position, circleA->radius, axis);
+			glm::vec2 rangeB = projectCircle(circleA.center, circleA.radius, axis);
 
-			if (rangeA.x >= rangeB.y || rangeB.x >= rangeA.y)
+			if (rangeA.x >= rangeB.y + speculativeDistance || rangeB.x >= rangeA.y + speculativeDistance)
 			{
 				return false;
 			}
@@ -316,13 +372,13 @@ bool Collisions::circlePolygon(CollisionManifold& result, const RigidBody* bodyA
 			}
 		}
 
-		glm::vec2 closestPoint = findClosestVertexOnPolygon(bodyA->position, vertices);
-		glm::vec2 axis = glm::normalize(closestPoint - circleA->position);
+		glm::vec2 closestPoint = findClosestVertexOnPolygon(circleA.center, vertices);
+		glm::vec2 axis = glm::normalize(closestPoint - circleA.center);
 
 		glm::vec2 rangeA = projectVertices(vertices, axis);
-		glm::vec2 rangeB = projectCircle(circleA->position, circleA->radius, axis);
+		glm::vec2 rangeB = projectCircle(circleA.center, circleA.radius, axis);
 
-		if (rangeA.x >= rangeB.y || rangeB.x >= rangeA.y)
+		if (rangeA.x >= rangeB.y + speculativeDistance || rangeB.x >= rangeA.y + speculativeDistance)
 		{
 			return false;
 		}
@@ -346,6 +402,7 @@ bool Collisions::circlePolygon(CollisionManifold& result, const RigidBody* bodyA
 	// Find contact point
 	// TODO: Maybe do that in the first loop
 	glm::vec2 closestContact;
+	unsigned int closestFeatureId = 0;
 	{
 		float minDistanceSquared = FLT_MAX;
 		for (size_t i = 0; i < verticesCount; i++)
@@ -354,12 +411,13 @@ bool Collisions::circlePolygon(CollisionManifold& result, const RigidBody* bodyA
 			glm::vec2 vb = vertices[(i + 1) % verticesCount];
 
 			float distanceSquared;
-			glm::vec2 contact = findClosestPointOnSegment(va, vb, circleA->position, distanceSquared);
+			glm::vec2 contact = findClosestPointOnSegment(va, vb, circleA.center, distanceSquared);
 		
 			if (distanceSquared < minDistanceSquared)
 			{
 				minDistanceSquared = distanceSquared;
 				closestContact = contact;
+				closestFeatureId = makeFeatureId(0, 0, i);
 			}
 		}
 	}
@@ -367,49 +425,158 @@ bool Collisions::circlePolygon(CollisionManifold& result, const RigidBody* bodyA
 	result.normal = -normal;
 	result.depth = depth;
 	result.contacts[0] = closestContact;
+	result.separations[0] = -depth;
+	result.featureIds[0] = closestFeatureId;
 	result.countOfContacts = 1;
 	return true;
 }
 
-void Collisions::checkCollision(std::unique_ptr<RigidBody>& bodyA, std::unique_ptr<RigidBody>& bodyB)
+void Collisions::checkCollision(RigidBody* bodyA, RigidBody* bodyB)
 {
-	checkCollision(bodyA.get(), bodyB.get());
+	// Keep order of bodies stable between steps, so contacts can be matched with the ones from previous step
+	if (bodyB < bodyA)
+	{
+		std::swap(bodyA, bodyB);
+	}
+
+	if (bodyA->shapeType == ShapeType::Compound || bodyB->shapeType == ShapeType::Compound)
+	{
+		checkCompoundCollision(bodyA, bodyB);
+		return;
+	}
+
+	CollisionManifold manifold;
+	const float speculativeDistance = bodyA->getSpeculativeDistance() + bodyB->getSpeculativeDistance();
+	if (!checkShapes(manifold, getConvexShape(bodyA, 0), getConvexShape(bodyB, 0), speculativeDistance))
+	{
+		return;
+	}
+
+	manifold.bodyA = bodyA;
+	manifold.bodyB = bodyB;
+
+	manifolds.push_back(manifold);
 }
 
-void Collisions::checkCollision(RigidBody* bodyA_, RigidBody* bodyB_)
+ConvexShape Collisions::getConvexShape(const RigidBody* body, unsigned int index)
 {
-	CollisionManifold manifold;
+	ConvexShape shape;
+	shape.shapeType = body->shapeType;
+	shape.index = index;
+	shape.aabb = &body->getAABB_noUpdate();
 
-	RigidBody* bodyA = bodyA_;
-	RigidBody* bodyB = bodyB_;
+	if (body->shapeType == ShapeType::Circle)
+	{
+		const RigidCircle* circle = static_cast<const RigidCircle*>(body);
+		shape.center = circle->getPosition();
+		shape.radius = circle->radius;
+		shape.vertices = nullptr;
+	}
+	else
+	{
+		const RigidPolygon* polygon = static_cast<const RigidPolygon*>(body);
+		shape.center = polygon->getCenterOfMass();
+		shape.radius = polygon->getBoundingRadius();
+		shape.vertices = &polygon->getTransformedVertices();
+	}
+	return shape;
+}
+
+bool Collisions::checkShapes(CollisionManifold& result, const ConvexShape& shapeA_, const ConvexShape& shapeB_, float speculativeDistance)
+{
+	const ConvexShape* shapeA = &shapeA_;
+	const ConvexShape* shapeB = &shapeB_;
 
-	const bool swap = (size_t)bodyB->shapeType < (size_t)bodyA->shapeType;
+	const bool swap = (size_t)shapeB->shapeType < (size_t)shapeA->shapeType;
 	if (swap)
 	{
-		auto temp = bodyA;
-		bodyA = bodyB;
-		bodyB = temp;
+		auto temp = shapeA;
+		shapeA = shapeB;
+		shapeB = temp;
 	}
 
-	auto func = checkCollisionFunctionsMatrix[(size_t)bodyA->shapeType][(size_t)bodyB->shapeType];
-	bool colliding = func(manifold, bodyA, bodyB);
+	auto func = checkCollisionFunctionsMatrix[(size_t)shapeA->shapeType][(size_t)shapeB->shapeType];
+	bool colliding = func(result, *shapeA, *shapeB, speculativeDistance);
 	if (!colliding)
 	{
-		return;
+		return false;
 	}
 
 	if (swap)
 	{
-		manifold.normal = -manifold.normal;
+		result.normal = -result.normal;
 	}
+	return true;
+}
 
-	manifold.bodyA = bodyA_;
-	manifold.bodyB = bodyB_;
+void Collisions::checkCompoundCollision(RigidBody* bodyA, RigidBody* bodyB)
+{
+	// Gather convex pieces of both bodies. Child tree of compound skips children, that don't touch other body
+	static std::vector<ConvexShape> shapesA, shapesB;
+	shapesA.clear();
+	shapesB.clear();
 
-	manifolds.push_back(manifold);
+	auto gatherShapes = [](const RigidBody* body, const AABB& otherAABB, std::vector<ConvexShape>& shapes)
+		{
+			if (body->shapeType != ShapeType::Compound)
+			{
+				shapes.push_back(getConvexShape(body, 0));
+				return;
+			}
+
+			static std::vector<int> childIndices;
+			childIndices.clear();
+
+			const RigidCompound* compound = static_cast<const RigidCompound*>(body);
+			compound->queryChildren(otherAABB, childIndices);
+
+			const auto& children = compound->getChildren();
+			for (int childIndex : childIndices)
+			{
+				const auto& child = children[childIndex];
+
+				ConvexShape shape;
+				shape.shapeType = child.shapeType;
+				shape.index = (unsigned int)childIndex;
+				shape.center = child.transformedCenter;
+				shape.radius = child.radius;
+				shape.vertices = &child.transformedVertices;
+				shape.aabb = &child.aabb;
+				shapes.push_back(shape);
+			}
+		};
+
+	gatherShapes(bodyA, bodyB->getAABB(), shapesA);
+	gatherShapes(bodyB, bodyA->getAABB(), shapesB);
+
+	const float speculativeDistance = bodyA->getSpeculativeDistance() + bodyB->getSpeculativeDistance();
+
+	for (const auto& shapeA : shapesA)
+	{
+		for (const auto& shapeB : shapesB)
+		{
+			if (!shapeA.aabb->isIntersecting(*shapeB.aabb))
+			{
+				continue;
+			}
+
+			CollisionManifold manifold;
+			if (!checkShapes(manifold, shapeA, shapeB, speculativeDistance))
+			{
+				continue;
+			}
+
+			manifold.bodyA = bodyA;
+			manifold.bodyB = bodyB;
+			manifold.childA = shapeA.index;
+			manifold.childB = shapeB.index;
+
+			manifolds.push_back(manifold);
+		}
+	}
 }
 
-const std::vector<CollisionManifold>& Collisions::getManifolds()
+std::vector<CollisionManifold>& Collisions::getManifolds()
 {
 	return manifolds;
 }
@@ -422,4 +589,4 @@ bool Collisions::areAnyCollisionsFound()
 void Collisions::clearManifolds()
 {
 	manifolds.clear();
-}
\ No newline at end of file
+}
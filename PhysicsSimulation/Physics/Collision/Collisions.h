@@ -1,45 +1,74 @@
 #pragma once
 #include "Physics/Bodies/RigidCircle.h"
 #include "Physics/Bodies/RigidPolygon.h"
+#include "Physics/Bodies/RigidCompound.h"
 
 #include <memory>
 
+struct CachedContact;
+
 struct CollisionManifold
 {
 	RigidBody* bodyA;
 	RigidBody* bodyB;
+	unsigned int childA = 0, childB = 0; // Children of compound bodies, that collided
 	glm::vec2 normal;
 	float depth = -1.0f;
 	glm::vec2 contacts[2];
+	float separations[2] = {}; // Per contact. Negative, when shapes overlap
+	unsigned int featureIds[2] = {};
 	unsigned int countOfContacts = 0;
 
+	// Persistent impulses of each contact, set by ContactCache
+	CachedContact* cachedContacts[2] = {};
+
 	CollisionManifold() = default;
 };
 
+// Single convex piece of a body, that narrowphase works with
+struct ConvexShape
+{
+	ShapeType shapeType; // Circle or Polygon
+	unsigned int index; // Child index for compound bodies
+	glm::vec2 center;
+	float radius; // Bounding circle for polygons
+	const PolygonVertices* vertices;
+	const AABB* aabb;
+};
+
 class Collisions
 {
 	static std::vector<CollisionManifold> manifolds;
 
 	using CheckCollisionFunction = bool(*)(
 		CollisionManifold&,
-		const RigidBody*,
-		const RigidBody*);
+		const ConvexShape&,
+		const ConvexShape&,
+		float);
 
 	static const CheckCollisionFunction checkCollisionFunctionsMatrix[2][2];
 
-	static glm::vec2 projectVertices(const std::vector<glm::vec2>& vertices, glm::vec2 axis);
+	static glm::vec2 projectVertices(const PolygonVertices& vertices, glm::vec2 axis);
 	static glm::vec2 projectCircle(const glm::vec2& position, float radius, glm::vec2 axis);
-	static glm::vec2 findClosestVertexOnPolygon(const glm::vec2& point, const std::vector<glm::vec2>& vertices);
+	static glm::vec2 findClosestVertexOnPolygon(const glm::vec2& point, const PolygonVertices& vertices);
+	static unsigned int makeFeatureId(unsigned int side, size_t vertexIndex, size_t edgeIndex);
+	static void findSupportEdge(const PolygonVertices& vertices, const glm::vec2& direction, size_t outVertices[2]);
+	static void clipSegment(glm::vec2 points[2], const glm::vec2& planeNormal, float planeOffset);
+	static bool areBoundingCirclesIntersecting(const ConvexShape& shapeA, const ConvexShape& shapeB, float speculativeDistance);
 	static glm::vec2 findClosestPointOnSegment(const glm::vec2& start, const glm::vec2& end, const glm::vec2& point, float& outDistanceSquared);
 
-	static bool circleCircle(CollisionManifold& result, const RigidBody* bodyA, const RigidBody* bodyB);
-	static bool polygonPolygon(CollisionManifold& result, const RigidBody* bodyA, const RigidBody* bodyB);
-	static bool circlePolygon(CollisionManifold& result, const RigidBody* bodyA, const RigidBody* bodyB);
+	// Shapes, that are apart by less than speculative distance, are reported too. Their separation is positive and depth is negative
+	static bool circleCircle(CollisionManifold& result, const ConvexShape& shapeA, const ConvexShape& shapeB, float speculativeDistance);
+	static bool polygonPolygon(CollisionManifold& result, const ConvexShape& shapeA, const ConvexShape& shapeB, float speculativeDistance);
+	static bool circlePolygon(CollisionManifold& result, const ConvexShape& shapeA, const ConvexShape& shapeB, float speculativeDistance);
+
+	static ConvexShape getConvexShape(const RigidBody* body, unsigned int index);
+	static bool checkShapes(CollisionManifold& result, const ConvexShape& shapeA, const ConvexShape& shapeB, float speculativeDistance);
+	static void checkCompoundCollision(RigidBody* bodyA, RigidBody* bodyB);
 public:
-	static void checkCollision(std::unique_ptr<RigidBody>& bodyA, std::unique_ptr<RigidBody>& bodyB);
 	static void checkCollision(RigidBody* bodyA, RigidBody* bodyB);
 
-	static const std::vector<CollisionManifold>& getManifolds();
+	static std::vector<CollisionManifold>& getManifolds();
 	static bool areAnyCollisionsFound();
 	static void clearManifolds();
 };
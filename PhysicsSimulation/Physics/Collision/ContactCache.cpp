@@ -0,0 +1,134 @@
+#include "ContactCache.h"
+
+#include "Core/Profiler.h"
+
+#include <algorithm>
+
+bool ContactKey::operator==(const ContactKey& other) const
+{
+	return bodyA == other.bodyA && bodyB == other.bodyB && childA == other.childA && childB == other.childB;
+}
+
+ContactCache::ContactCache()
+{
+	cache.reserve(256);
+}
+
+void ContactCache::beginStep()
+{
+	PROFILE_FUNCTION();
+
+	auto it = cache.begin();
+	while (it != cache.end())
+	{
+		CachedManifold& manifold = it->second;
+		if (!manifold.touched)
+		{
+			it = cache.erase(it);
+			continue;
+		}
+
+		// Keep only contacts, that existed during finished step
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
+		{
+			CachedContact& contact = manifold.contacts[i];
+			if (!contact.touched)
+			{
+				continue;
+			}
+
+			CachedContact& kept = manifold.contacts[count++];
+			kept.featureId = contact.featureId;
+			kept.normal = contact.normal;
+			kept.previousNormalImpulse = contact.normalImpulse;
+			kept.previousTangentImpulse = contact.tangentImpulse;
+			kept.normalImpulse = 0.0f;
+			kept.tangentImpulse = 0.0f;
+			kept.approachVelocity = 0.0f;
+			kept.isPrepared = false;
+			kept.touched = false;
+		}
+		manifold.countOfContacts = count;
+		manifold.touched = false;
+		++it;
+	}
+}
+
+void ContactCache::matchManifolds(std::vector<CollisionManifold>& manifolds)
+{
+	PROFILE_FUNCTION();
+
+	for (auto& manifold : manifolds)
+	{
+		ContactKey key = { manifold.bodyA, manifold.bodyB, manifold.childA, manifold.childB };
+		CachedManifold& cached = cache[key];
+		cached.touched = true;
+
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
+		{
+			unsigned int featureId = manifold.featureIds[i];
+
+			CachedContact* match = nullptr;
+			for (unsigned int j = 0; j < cached.countOfContacts; j++)
+			{
+				if (cached.contacts[j].featureId == featureId)
+				{
+					match = &cached.contacts[j];
+					break;
+				}
+			}
+
+			if (match == nullptr)
+			{
+				// New contact. If there is no room, the last slot is reused
+				unsigned int slot = cached.countOfContacts < MAX_CACHED_CONTACTS ? cached.countOfContacts++ : MAX_CACHED_CONTACTS - 1;
+				match = &cached.contacts[slot];
+				*match = CachedContact();
+				match->featureId = featureId;
+			}
+
+			else if (!match->touched && glm::dot(match->normal, manifold.normal) < MIN_NORMAL_SIMILARITY)
+			{
+				// Same features, but contact turned over. Old impulses would push bodies in wrong direction
+				match->previousNormalImpulse = 0.0f;
+				match->previousTangentImpulse = 0.0f;
+			}
+
+			match->normal = manifold.normal;
+			match->touched = true;
+			manifold.cachedContacts[i] = match;
+		}
+	}
+}
+
+void ContactCache::removeBodies(std::vector<const RigidBody*>& bodies)
+{
+	PROFILE_FUNCTION();
+
+	// Removed bodies are collected between steps, so cache is searched once for all of them
+	std::sort(bodies.begin(), bodies.end());
+	auto it = cache.begin();
+	while (it != cache.end())
+	{
+		const ContactKey& key = it->first;
+		if (std::binary_search(bodies.begin(), bodies.end(), key.bodyA) || std::binary_search(bodies.begin(), bodies.end(), key.bodyB))
+		{
+			it = cache.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void ContactCache::clear()
+{
+	cache.clear();
+}
+
+size_t ContactCache::size() const
+{
+	return cache.size();
+}
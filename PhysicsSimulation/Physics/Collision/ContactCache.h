@@ -0,0 +1,75 @@
+#pragma once
+#include "Collisions.h"
+
+#include <unordered_map>
+
+// Impulses of a single contact, that survive between steps
+struct CachedContact
+{
+	unsigned int featureId = 0;
+	glm::vec2 normal = { 0.0f, 0.0f };
+
+	// Applied during current step
+	float normalImpulse = 0.0f;
+	float tangentImpulse = 0.0f;
+
+	// Applied during previous step, used for warm starting
+	float previousNormalImpulse = 0.0f;
+	float previousTangentImpulse = 0.0f;
+
+	// Normal velocity before any impulses of current step. Restitution bounces bodies with it at the end of step
+	float approachVelocity = 0.0f;
+	bool isPrepared = false;
+
+	bool touched = false;
+};
+
+struct ContactKey
+{
+	const RigidBody* bodyA;
+	const RigidBody* bodyB;
+	unsigned int childA, childB;
+
+	bool operator==(const ContactKey& other) const;
+};
+
+struct ContactKeyHash
+{
+	size_t operator()(const ContactKey& key) const noexcept
+	{
+		size_t h1 = (size_t)key.bodyA;
+		size_t h2 = (size_t)key.bodyB;
+		size_t h3 = ((size_t)key.childA << 16) ^ (size_t)key.childB;
+		return h1 ^ (h2 << 1) ^ (h3 << 7);
+	}
+};
+
+// Keeps accumulated impulses of contacts between steps, keyed by body pair and contact feature
+class ContactCache
+{
+	static constexpr unsigned int MAX_CACHED_CONTACTS = 4;
+	static constexpr float MIN_NORMAL_SIMILARITY = 0.95f;
+
+	struct CachedManifold
+	{
+		CachedContact contacts[MAX_CACHED_CONTACTS];
+		unsigned int countOfContacts = 0;
+		bool touched = false;
+	};
+
+	std::unordered_map<ContactKey, CachedManifold, ContactKeyHash> cache;
+public:
+	ContactCache();
+
+	// Moves impulses of finished step into warm starting slots and forgets contacts, that weren't touched
+	void beginStep();
+
+	// Links manifold contacts with cached ones
+	void matchManifolds(std::vector<CollisionManifold>& manifolds);
+
+	// Forgets contacts of removed bodies. Their places in pools are reused, so new body could get impulses of removed one otherwise
+	void removeBodies(std::vector<const RigidBody*>& bodies);
+
+	void clear();
+	size_t size() const;
+};
@@ -0,0 +1,594 @@
+#include "ConstraintStorage.h"
+
+#include "Core/CoreMath.h"
+#include "Core/SimdMath.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+	// Last element takes place of removed one
+	template<typename T>
+	void swapRemove(std::vector<T>& items, size_t index)
+	{
+		items[index] = std::move(items.back());
+		items.pop_back();
+	}
+
+	// Body has only a few constraints, so its list is searched
+	void forgetHandle(std::vector<ConstraintHandle>& bodyHandles, ConstraintHandle handle)
+	{
+		auto it = std::find(bodyHandles.begin(), bodyHandles.end(), handle);
+		if (it != bodyHandles.end())
+		{
+			swapRemove(bodyHandles, it - bodyHandles.begin());
+		}
+	}
+
+	// Calls func(constraintIndex) for every colored constraint, each color in parallel, serial ones last
+	template<typename Func>
+	void forEachByColors(const ConstraintColors& colors, size_t minPerTask, Func func)
+	{
+		const size_t countOfColors = colors.getCountOfColors();
+		for (size_t color = 0; color < countOfColors; color++)
+		{
+			ParallelUtils::parallelFor(colors.offsets[color], colors.offsets[color + 1], minPerTask, [&colors, &func](size_t i)
+				{
+					func(colors.order[i]);
+				});
+		}
+
+		for (size_t i = colors.offsets[countOfColors]; i < colors.order.size(); i++)
+		{
+			func(colors.order[i]);
+		}
+	}
+}
+
+size_t ConstraintColors::getCountOfColors() const
+{
+	return offsets.size() - 1;
+}
+
+size_t SpringConstraints::size() const
+{
+	return bodiesA.size();
+}
+
+void SpringConstraints::swapRemove(size_t index)
+{
+	::swapRemove(bodiesA, index);
+	::swapRemove(bodiesB, index);
+	::swapRemove(localAnchorsA, index);
+	::swapRemove(localAnchorsB, index);
+	::swapRemove(distances, index);
+	::swapRemove(stiffnesses, index);
+}
+
+size_t AxisConstraints::size() const
+{
+	return bodies.size();
+}
+
+void AxisConstraints::swapRemove(size_t index)
+{
+	::swapRemove(bodies, index);
+	::swapRemove(fixedPositions, index);
+	::swapRemove(disableX, index);
+	::swapRemove(disableY, index);
+}
+
+size_t AngularVelocityConstraints::size() const
+{
+	return bodies.size();
+}
+
+void AngularVelocityConstraints::swapRemove(size_t index)
+{
+	::swapRemove(bodies, index);
+	::swapRemove(angularVelocities, index);
+}
+
+ConstraintHandle ConstraintStorage::addSpring(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float stiffness)
+{
+	springs.bodiesA.push_back(bodyA);
+	springs.bodiesB.push_back(bodyB);
+	springs.localAnchorsA.push_back(anchorA);
+	springs.localAnchorsB.push_back(anchorB);
+	springs.distances.push_back(distance);
+	springs.stiffnesses.push_back(stiffness);
+	return registerConstraint({ ConstraintType::Spring, (unsigned int)(springs.size() - 1) }, bodyA, bodyB);
+}
+
+ConstraintHandle ConstraintStorage::addAxis(RigidBody* body, bool disableX, bool disableY)
+{
+	axisConstraints.bodies.push_back(body);
+	axisConstraints.fixedPositions.push_back(body->getPosition());
+	axisConstraints.disableX.push_back(disableX);
+	axisConstraints.disableY.push_back(disableY);
+	return registerConstraint({ ConstraintType::Axis, (unsigned int)(axisConstraints.size() - 1) }, body, nullptr);
+}
+
+ConstraintHandle ConstraintStorage::addAngularVelocity(RigidBody* body, float angularVelocity)
+{
+	angularVelocityConstraints.bodies.push_back(body);
+	angularVelocityConstraints.angularVelocities.push_back(angularVelocity);
+	return registerConstraint({ ConstraintType::AngularVelocity, (unsigned int)(angularVelocityConstraints.size() - 1) }, body, nullptr);
+}
+
+ConstraintHandle ConstraintStorage::addRevoluteJoint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB)
+{
+	RevoluteJoint joint;
+	joint.bodyA = bodyA;
+	joint.bodyB = bodyB;
+	joint.localAnchorA = anchorA;
+	joint.localAnchorB = anchorB;
+	revoluteJoints.push_back(joint);
+	return registerConstraint({ ConstraintType::RevoluteJoint, (unsigned int)(revoluteJoints.size() - 1) }, bodyA, bodyB);
+}
+
+ConstraintHandle ConstraintStorage::addDistanceJoint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float length)
+{
+	DistanceJoint joint;
+	joint.bodyA = bodyA;
+	joint.bodyB = bodyB;
+	joint.localAnchorA = anchorA;
+	joint.localAnchorB = anchorB;
+	joint.length = length;
+	distanceJoints.push_back(joint);
+	return registerConstraint({ ConstraintType::DistanceJoint, (unsigned int)(distanceJoints.size() - 1) }, bodyA, bodyB);
+}
+
+ConstraintHandle ConstraintStorage::addPrismaticJoint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, const glm::vec2& localAxisA)
+{
+	PrismaticJoint joint;
+	joint.bodyA = bodyA;
+	joint.bodyB = bodyB;
+	joint.localAnchorA = anchorA;
+	joint.localAnchorB = anchorB;
+	joint.localAxisA = glm::normalize(localAxisA);
+	joint.referenceAngle = bodyB->getRotation() - bodyA->getRotation();
+	prismaticJoints.push_back(joint);
+	return registerConstraint({ ConstraintType::PrismaticJoint, (unsigned int)(prismaticJoints.size() - 1) }, bodyA, bodyB);
+}
+
+ConstraintHandle ConstraintStorage::addWeldJoint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB)
+{
+	WeldJoint joint;
+	joint.bodyA = bodyA;
+	joint.bodyB = bodyB;
+	joint.localAnchorA = anchorA;
+	joint.localAnchorB = anchorB;
+	joint.referenceAngle = bodyB->getRotation() - bodyA->getRotation();
+	weldJoints.push_back(joint);
+	return registerConstraint({ ConstraintType::WeldJoint, (unsigned int)(weldJoints.size() - 1) }, bodyA, bodyB);
+}
+
+ConstraintHandle ConstraintStorage::addSoftSpring(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float frequency, float dampingRatio)
+{
+	SoftSpringJoint joint;
+	joint.bodyA = bodyA;
+	joint.bodyB = bodyB;
+	joint.localAnchorA = anchorA;
+	joint.localAnchorB = anchorB;
+	joint.distance = distance;
+	joint.frequency = frequency;
+	joint.dampingRatio = dampingRatio;
+	softSprings.push_back(joint);
+	return registerConstraint({ ConstraintType::SoftSpring, (unsigned int)(softSprings.size() - 1) }, bodyA, bodyB);
+}
+
+ConstraintHandle ConstraintStorage::registerConstraint(ConstraintId id, RigidBody* bodyA, RigidBody* bodyB)
+{
+	ConstraintHandle handle = handles.add(id);
+	handleSlots[(size_t)id.type].push_back(handle.index);
+
+	bodyA->constraintHandles.push_back(handle);
+	if (bodyB)
+	{
+		bodyB->constraintHandles.push_back(handle);
+	}
+	colorsDirty = true;
+	return handle;
+}
+
+bool ConstraintStorage::remove(ConstraintHandle handle)
+{
+	const ConstraintId* id = handles.find(handle);
+	if (!id)
+	{
+		return false;
+	}
+
+	removeAt(*id);
+	return true;
+}
+
+bool ConstraintStorage::isValid(ConstraintHandle handle) const
+{
+	return handles.isValid(handle);
+}
+
+void ConstraintStorage::removeConstraintsOf(RigidBody* body)
+{
+	// Removing constraint takes its handle out of body's list
+	while (!body->constraintHandles.empty())
+	{
+		remove(body->constraintHandles.back());
+	}
+}
+
+void ConstraintStorage::removeAt(ConstraintId id)
+{
+	std::vector<unsigned int>& slots = handleSlots[(size_t)id.type];
+	const ConstraintHandle handle = handles.getHandle(slots[id.index]);
+
+	std::pair<RigidBody*, RigidBody*> bodies = getBodiesOf(id);
+	forgetHandle(bodies.first->constraintHandles, handle);
+	if (bodies.second)
+	{
+		forgetHandle(bodies.second->constraintHandles, handle);
+	}
+
+	handles.remove(handle);
+	swapRemove(slots, id.index);
+	if (id.index < slots.size())
+	{
+		handles.at(slots[id.index]).index = id.index;
+	}
+
+	switch (id.type)
+	{
+	case ConstraintType::Spring:
+		springs.swapRemove(id.index);
+		break;
+	case ConstraintType::Axis:
+		axisConstraints.swapRemove(id.index);
+		break;
+	case ConstraintType::AngularVelocity:
+		angularVelocityConstraints.swapRemove(id.index);
+		break;
+	case ConstraintType::RevoluteJoint:
+		swapRemove(revoluteJoints, id.index);
+		break;
+	case ConstraintType::DistanceJoint:
+		swapRemove(distanceJoints, id.index);
+		break;
+	case ConstraintType::PrismaticJoint:
+		swapRemove(prismaticJoints, id.index);
+		break;
+	case ConstraintType::WeldJoint:
+		swapRemove(weldJoints, id.index);
+		break;
+	case ConstraintType::SoftSpring:
+		swapRemove(softSprings, id.index);
+		break;
+	default:
+		break;
+	}
+	colorsDirty = true;
+}
+
+std::pair<RigidBody*, RigidBody*> ConstraintStorage::getBodiesOf(ConstraintId id) const
+{
+	switch (id.type)
+	{
+	case ConstraintType::Spring:
+		return { springs.bodiesA[id.index], springs.bodiesB[id.index] };
+	case ConstraintType::Axis:
+		return { axisConstraints.bodies[id.index], nullptr };
+	case ConstraintType::AngularVelocity:
+		return { angularVelocityConstraints.bodies[id.index], nullptr };
+	case ConstraintType::RevoluteJoint:
+		return { revoluteJoints[id.index].bodyA, revoluteJoints[id.index].bodyB };
+	case ConstraintType::DistanceJoint:
+		return { distanceJoints[id.index].bodyA, distanceJoints[id.index].bodyB };
+	case ConstraintType::PrismaticJoint:
+		return { prismaticJoints[id.index].bodyA, prismaticJoints[id.index].bodyB };
+	case ConstraintType::WeldJoint:
+		return { weldJoints[id.index].bodyA, weldJoints[id.index].bodyB };
+	case ConstraintType::SoftSpring:
+		return { softSprings[id.index].bodyA, softSprings[id.index].bodyB };
+	default:
+		return { nullptr, nullptr };
+	}
+}
+
+void ConstraintStorage::update(float timeStep)
+{
+	updateColors();
+
+	updateSprings(timeStep);
+	updateAxisConstraints();
+	updateAngularVelocityConstraints();
+}
+
+void ConstraintStorage::updateColors()
+{
+	if (!colorsDirty)
+	{
+		return;
+	}
+	colorsDirty = false;
+
+	colorConstraints(springs.size(), [this](size_t i)
+		{
+			return std::make_pair(springs.bodiesA[i], springs.bodiesB[i]);
+		}, springColors);
+
+	colorConstraints(axisConstraints.size(), [this](size_t i)
+		{
+			return std::make_pair(axisConstraints.bodies[i], (RigidBody*)nullptr);
+		}, axisColors);
+
+	colorConstraints(angularVelocityConstraints.size(), [this](size_t i)
+		{
+			return std::make_pair(angularVelocityConstraints.bodies[i], (RigidBody*)nullptr);
+		}, angularVelocityColors);
+}
+
+template<typename BodiesOf>
+void ConstraintStorage::colorConstraints(size_t count, BodiesOf bodiesOf, ConstraintColors& colors)
+{
+	std::fill(bodyColors.begin(), bodyColors.end(), 0);
+
+	// Greedy coloring, same as of contacts. Static bodies aren't written, so they don't take colors.
+	// Constraints of only static bodies are never applied, they keep color after serial one and are dropped
+	const unsigned int skippedColor = MAX_COLORS + 1;
+	std::vector<unsigned int> constraintColors(count, skippedColor);
+	std::vector<size_t> colorSizes(MAX_COLORS + 1, 0);
+	unsigned int countOfColors = 0;
+	size_t countOfColored = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		std::pair<RigidBody*, RigidBody*> bodies = bodiesOf(i);
+		RigidBody* dynamicBodies[2] = {};
+		unsigned int countOfDynamic = 0;
+		if (!bodies.first->isStatic())
+		{
+			dynamicBodies[countOfDynamic++] = bodies.first;
+		}
+		if (bodies.second && !bodies.second->isStatic())
+		{
+			dynamicBodies[countOfDynamic++] = bodies.second;
+		}
+
+		if (countOfDynamic == 0)
+		{
+			continue;
+		}
+
+		uint64_t usedColors = 0;
+		for (unsigned int b = 0; b < countOfDynamic; b++)
+		{
+			const unsigned int bodyIndex = dynamicBodies[b]->bodyIndex;
+			if (bodyIndex >= bodyColors.size())
+			{
+				bodyColors.resize(bodyIndex + 1, 0);
+			}
+			usedColors |= bodyColors[bodyIndex];
+		}
+
+		unsigned int color = MAX_COLORS;
+		for (unsigned int c = 0; c < MAX_COLORS; c++)
+		{
+			if ((usedColors & (uint64_t(1) << c)) == 0)
+			{
+				color = c;
+				break;
+			}
+		}
+
+		if (color != MAX_COLORS)
+		{
+			uint64_t bit = uint64_t(1) << color;
+			for (unsigned int b = 0; b < countOfDynamic; b++)
+			{
+				bodyColors[dynamicBodies[b]->bodyIndex] |= bit;
+			}
+			countOfColors = std::max(countOfColors, color + 1);
+		}
+
+		constraintColors[i] = color;
+		colorSizes[color]++;
+		countOfColored++;
+	}
+
+	// Counting sort by color. Serial constraints go last
+	colors.offsets.resize(countOfColors + 1);
+	size_t offset = 0;
+	for (unsigned int color = 0; color < countOfColors; color++)
+	{
+		colors.offsets[color] = offset;
+		offset += colorSizes[color];
+	}
+	colors.offsets[countOfColors] = offset;
+
+	std::vector<size_t> cursors(colors.offsets.begin(), colors.offsets.end());
+	colors.order.resize(countOfColored);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (constraintColors[i] == skippedColor)
+		{
+			continue;
+		}
+
+		unsigned int color = std::min(constraintColors[i], countOfColors);
+		colors.order[cursors[color]++] = (unsigned int)i;
+	}
+}
+
+void ConstraintStorage::updateSprings(float timeStep)
+{
+	const size_t count = springs.size();
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Anchors of all springs are rotated with one batched sin/cos pass
+	springRotations.resize(count * 2);
+	for (size_t i = 0; i < count; i++)
+	{
+		springRotations[i] = springs.bodiesA[i]->getRotation();
+		springRotations[count + i] = springs.bodiesB[i]->getRotation();
+	}
+	springCosSin.resize(count * 2);
+	SimdMath::cosSin(springRotations.data(), springCosSin.data(), count * 2);
+
+	// Impulses depend only on positions, so they are computed in parallel and applied afterwards
+	springImpulses.resize(count);
+	springArmsA.resize(count);
+	springArmsB.resize(count);
+	ParallelUtils::parallelFor(0, count, MIN_SPRINGS_PER_TASK, [this, count, timeStep](size_t i)
+		{
+			const RigidBody* bodyA = springs.bodiesA[i];
+			const RigidBody* bodyB = springs.bodiesB[i];
+			const glm::vec2 cosSinA = springCosSin[i];
+			const glm::vec2 cosSinB = springCosSin[count + i];
+			const glm::vec2& anchorA = springs.localAnchorsA[i];
+			const glm::vec2& anchorB = springs.localAnchorsB[i];
+
+			glm::vec2 posA = bodyA->getPosition() + glm::vec2(anchorA.x * cosSinA.x - anchorA.y * cosSinA.y, anchorA.x * cosSinA.y + anchorA.y * cosSinA.x);
+			glm::vec2 posB = bodyB->getPosition() + glm::vec2(anchorB.x * cosSinB.x - anchorB.y * cosSinB.y, anchorB.x * cosSinB.y + anchorB.y * cosSinB.x);
+			glm::vec2 dpos = posB - posA;
+
+			// Coincident anchors have no direction, so they get zero impulse
+			float distance = glm::length(dpos);
+			float invDistance = distance > 0.0f ? 1.0f / distance : 0.0f;
+
+			float difference = springs.distances[i] - distance;
+			springImpulses[i] = dpos * (invDistance * difference * springs.stiffnesses[i] * timeStep);
+			springArmsA[i] = posA - bodyA->getCenterOfMass();
+			springArmsB[i] = posB - bodyB->getCenterOfMass();
+		});
+
+	// Springs share bodies, so impulses are applied color by color. Static body is shared by springs of one color, so it isn't written
+	forEachByColors(springColors, MIN_SPRINGS_PER_TASK, [this](size_t i)
+		{
+			RigidBody* bodyA = springs.bodiesA[i];
+			RigidBody* bodyB = springs.bodiesB[i];
+			if (!bodyA->isAwake() && !bodyB->isAwake())
+			{
+				return;
+			}
+
+			// Sleeping body isn't integrated, so one pulled by awake body wakes up. Color owns both bodies, so it's safe here
+			if (bodyA->isSleeping())
+			{
+				bodyA->wakeUp();
+			}
+			if (bodyB->isSleeping())
+			{
+				bodyB->wakeUp();
+			}
+
+			const glm::vec2& impulse = springImpulses[i];
+			if (!bodyA->isStatic())
+			{
+				bodyA->setVelocity(bodyA->getVelocity() - impulse * bodyA->getInvMass());
+				bodyA->setAngularVelocity(bodyA->getAngularVelocity() - CoreMath::cross(springArmsA[i], impulse) * bodyA->getInvInertia());
+			}
+			if (!bodyB->isStatic())
+			{
+				bodyB->setVelocity(bodyB->getVelocity() + impulse * bodyB->getInvMass());
+				bodyB->setAngularVelocity(bodyB->getAngularVelocity() + CoreMath::cross(springArmsB[i], impulse) * bodyB->getInvInertia());
+			}
+		});
+}
+
+void ConstraintStorage::updateAxisConstraints()
+{
+	forEachByColors(axisColors, MIN_SINGLE_BODY_CONSTRAINTS_PER_TASK, [this](size_t i)
+		{
+			RigidBody* body = axisConstraints.bodies[i];
+			if (!body->isAwake())
+			{
+				return;
+			}
+
+			const glm::vec2& fixedPosition = axisConstraints.fixedPositions[i];
+			glm::vec2 position = body->getPosition();
+			glm::vec2 velocity = body->getVelocity();
+			if (axisConstraints.disableX[i])
+			{
+				position.x = fixedPosition.x;
+				velocity.x = 0.0f;
+			}
+			if (axisConstraints.disableY[i])
+			{
+				position.y = fixedPosition.y;
+				velocity.y = 0.0f;
+			}
+			body->setPosition(position);
+			body->setVelocity(velocity);
+		});
+}
+
+void ConstraintStorage::updateAngularVelocityConstraints()
+{
+	updateColors();
+
+	forEachByColors(angularVelocityColors, MIN_SINGLE_BODY_CONSTRAINTS_PER_TASK, [this](size_t i)
+		{
+			RigidBody* body = angularVelocityConstraints.bodies[i];
+			if (!body->isAwake())
+			{
+				return;
+			}
+
+			body->setAngularVelocity(angularVelocityConstraints.angularVelocities[i]);
+		});
+}
+
+const SpringConstraints& ConstraintStorage::getSprings() const
+{
+	return springs;
+}
+
+const AxisConstraints& ConstraintStorage::getAxisConstraints() const
+{
+	return axisConstraints;
+}
+
+const AngularVelocityConstraints& ConstraintStorage::getAngularVelocityConstraints() const
+{
+	return angularVelocityConstraints;
+}
+
+std::vector<RevoluteJoint>& ConstraintStorage::getRevoluteJoints()
+{
+	return revoluteJoints;
+}
+
+std::vector<DistanceJoint>& ConstraintStorage::getDistanceJoints()
+{
+	return distanceJoints;
+}
+
+std::vector<PrismaticJoint>& ConstraintStorage::getPrismaticJoints()
+{
+	return prismaticJoints;
+}
+
+std::vector<WeldJoint>& ConstraintStorage::getWeldJoints()
+{
+	return weldJoints;
+}
+
+std::vector<SoftSpringJoint>& ConstraintStorage::getSoftSprings()
+{
+	return softSprings;
+}
+
+size_t ConstraintStorage::getCountOfJoints() const
+{
+	return revoluteJoints.size() + distanceJoints.size() + prismaticJoints.size() + weldJoints.size() + softSprings.size();
+}
+
+size_t ConstraintStorage::size() const
+{
+	return springs.size() + axisConstraints.size() + angularVelocityConstraints.size() + getCountOfJoints();
+}
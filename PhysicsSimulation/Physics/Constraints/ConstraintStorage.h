@@ -0,0 +1,188 @@
+#pragma once
+#include "Physics/Bodies/RigidBody.h"
+#include "Joints.h"
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+enum class ConstraintType : unsigned int
+{
+	Spring,
+	Axis,
+	AngularVelocity,
+	RevoluteJoint,
+	DistanceJoint,
+	PrismaticJoint,
+	WeldJoint,
+	SoftSpring,
+	_COUNT
+};
+
+// Position of constraint in array of its type. Changes, when other constraints are removed
+struct ConstraintId
+{
+	ConstraintType type;
+	unsigned int index;
+};
+
+// Stays the same, while constraint exists
+using ConstraintHandle = Handle<ConstraintId>;
+
+// Pulls anchors of two bodies to given distance with explicit impulse. Anchors are local to body's position
+struct SpringConstraints
+{
+	std::vector<RigidBody*> bodiesA, bodiesB;
+	std::vector<glm::vec2> localAnchorsA, localAnchorsB;
+	std::vector<float> distances, stiffnesses;
+
+	size_t size() const;
+	void swapRemove(size_t index);
+};
+
+// Locks body's position along disabled axes
+struct AxisConstraints
+{
+	std::vector<RigidBody*> bodies;
+	std::vector<glm::vec2> fixedPositions;
+	std::vector<uint8_t> disableX, disableY;
+
+	size_t size() const;
+	void swapRemove(size_t index);
+};
+
+// Keeps body's angular velocity
+struct AngularVelocityConstraints
+{
+	std::vector<RigidBody*> bodies;
+	std::vector<float> angularVelocities;
+
+	size_t size() const;
+	void swapRemove(size_t index);
+};
+
+// Indices of constraints of one type sorted by color. Constraints of one color don't share a dynamic body, so they may be applied in parallel.
+// Constraints, that didn't fit into any color, are stored after the last color and must be applied serially
+struct ConstraintColors
+{
+	std::vector<unsigned int> order;
+	std::vector<size_t> offsets; // Start of each color and of serial constraints
+
+	size_t getCountOfColors() const;
+};
+
+// Constraints stored as arrays per type, so each type is updated in its own tight loop instead of a virtual call per constraint.
+// Removed constraint is replaced by the last one of its type, handles follow moved constraints
+class ConstraintStorage
+{
+	const size_t MIN_SPRINGS_PER_TASK = 1024;
+	const size_t MIN_SINGLE_BODY_CONSTRAINTS_PER_TASK = 4096;
+
+	// Colors are stored as bits of a mask per body
+	const unsigned int MAX_COLORS = 64;
+
+	SpringConstraints springs;
+	AxisConstraints axisConstraints;
+	AngularVelocityConstraints angularVelocityConstraints;
+
+	// Joints aren't updated here, JointSolver solves them together with contacts
+	std::vector<RevoluteJoint> revoluteJoints;
+	std::vector<DistanceJoint> distanceJoints;
+	std::vector<PrismaticJoint> prismaticJoints;
+	std::vector<WeldJoint> weldJoints;
+	std::vector<SoftSpringJoint> softSprings;
+
+	HandleTable<ConstraintId, ConstraintId> handles;
+	std::vector<unsigned int> handleSlots[(size_t)ConstraintType::_COUNT]; // By type and position, so moved constraint can update its slot
+
+	// Scratch buffers of spring update. Rotations of bodies A come first, then of bodies B
+	std::vector<float> springRotations;
+	std::vector<glm::vec2> springCosSin;
+	std::vector<glm::vec2> springImpulses, springArmsA, springArmsB;
+
+	// Colors are rebuilt only after constraints are added or removed. Constraints of static bodies do nothing, so they aren't colored.
+	// Single body constraints only conflict with constraints of the same type on the same body, so they are batched apart from springs
+	ConstraintColors springColors, axisColors, angularVelocityColors;
+	std::vector<uint64_t> bodyColors; // By body index
+	bool colorsDirty = true;
+
+	void updateColors();
+
+	// BodiesOf(i) returns pair of bodies of constraint i, second body is nullptr for single body constraints
+	template<typename BodiesOf>
+	void colorConstraints(size_t count, BodiesOf bodiesOf, ConstraintColors& colors);
+
+	ConstraintHandle registerConstraint(ConstraintId id, RigidBody* bodyA, RigidBody* bodyB);
+	void removeAt(ConstraintId id);
+
+	// Second body is nullptr for single body constraints
+	std::pair<RigidBody*, RigidBody*> getBodiesOf(ConstraintId id) const;
+
+	void updateSprings(float timeStep);
+	void updateAxisConstraints();
+public:
+	ConstraintHandle addSpring(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float stiffness);
+	ConstraintHandle addAxis(RigidBody* body, bool disableX, bool disableY);
+	ConstraintHandle addAngularVelocity(RigidBody* body, float angularVelocity);
+
+	ConstraintHandle addRevoluteJoint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB);
+	ConstraintHandle addDistanceJoint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float length);
+	ConstraintHandle addPrismaticJoint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, const glm::vec2& localAxisA);
+	ConstraintHandle addWeldJoint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB);
+	ConstraintHandle addSoftSpring(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float frequency, float dampingRatio);
+
+	// Returns false for invalid handle
+	bool remove(ConstraintHandle handle);
+	bool isValid(ConstraintHandle handle) const;
+
+	// Removes every constraint attached to body, so it can be removed itself
+	void removeConstraintsOf(RigidBody* body);
+
+	// Constraints, whose bodies are all resting, are skipped, because velocity they add would never be integrated
+	void update(float timeStep);
+
+	// Position based solver projects springs and axis locks itself, it only needs angular velocities to be set
+	void updateAngularVelocityConstraints();
+
+	const SpringConstraints& getSprings() const;
+	const AxisConstraints& getAxisConstraints() const;
+	const AngularVelocityConstraints& getAngularVelocityConstraints() const;
+
+	std::vector<RevoluteJoint>& getRevoluteJoints();
+	std::vector<DistanceJoint>& getDistanceJoints();
+	std::vector<PrismaticJoint>& getPrismaticJoints();
+	std::vector<WeldJoint>& getWeldJoints();
+	std::vector<SoftSpringJoint>& getSoftSprings();
+	size_t getCountOfJoints() const;
+
+	// Calls func(ConstraintId, RigidBody* bodyA, RigidBody* bodyB) for every joint
+	template<typename Func>
+	void forEachJoint(Func func) const;
+
+	size_t size() const;
+};
+
+template<typename Func>
+void ConstraintStorage::forEachJoint(Func func) const
+{
+	for (size_t i = 0; i < revoluteJoints.size(); i++)
+	{
+		func(ConstraintId{ ConstraintType::RevoluteJoint, (unsigned int)i }, revoluteJoints[i].bodyA, revoluteJoints[i].bodyB);
+	}
+	for (size_t i = 0; i < distanceJoints.size(); i++)
+	{
+		func(ConstraintId{ ConstraintType::DistanceJoint, (unsigned int)i }, distanceJoints[i].bodyA, distanceJoints[i].bodyB);
+	}
+	for (size_t i = 0; i < prismaticJoints.size(); i++)
+	{
+		func(ConstraintId{ ConstraintType::PrismaticJoint, (unsigned int)i }, prismaticJoints[i].bodyA, prismaticJoints[i].bodyB);
+	}
+	for (size_t i = 0; i < weldJoints.size(); i++)
+	{
+		func(ConstraintId{ ConstraintType::WeldJoint, (unsigned int)i }, weldJoints[i].bodyA, weldJoints[i].bodyB);
+	}
+	for (size_t i = 0; i < softSprings.size(); i++)
+	{
+		func(ConstraintId{ ConstraintType::SoftSpring, (unsigned int)i }, softSprings[i].bodyA, softSprings[i].bodyB);
+	}
+}
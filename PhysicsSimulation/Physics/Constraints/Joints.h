@@ -0,0 +1,96 @@
+#pragma once
+#include "Physics/Bodies/RigidBody.h"
+
+// Joints are velocity constraints, that are solved together with contacts. Anchors are local to body's position.
+// Accumulated impulses are kept between steps for warm starting, other solver values are recomputed every step
+
+// Pins anchors of two bodies together, bodies rotate freely
+struct RevoluteJoint
+{
+	RigidBody* bodyA;
+	RigidBody* bodyB;
+	glm::vec2 localAnchorA, localAnchorB;
+
+	glm::vec2 impulse = glm::vec2(0.0f);
+
+	// Solver values
+	unsigned int indexA, indexB;
+	glm::vec2 rA, rB;
+	glm::mat2 mass;
+	glm::vec2 bias;
+};
+
+// Keeps anchors at fixed distance like a rigid rod
+struct DistanceJoint
+{
+	RigidBody* bodyA;
+	RigidBody* bodyB;
+	glm::vec2 localAnchorA, localAnchorB;
+	float length;
+
+	float impulse = 0.0f;
+
+	// Solver values
+	unsigned int indexA, indexB;
+	glm::vec2 rA, rB;
+	glm::vec2 axis;
+	float mass;
+	float bias;
+};
+
+// Spring between anchors, that is solved implicitly as soft constraint, so it stays stable at any stiffness and step.
+// Stiffness is set by frequency in hertz and damping ratio, so it doesn't depend on mass of bodies
+struct SoftSpringJoint
+{
+	RigidBody* bodyA;
+	RigidBody* bodyB;
+	glm::vec2 localAnchorA, localAnchorB;
+	float distance;
+	float frequency, dampingRatio;
+
+	float impulse = 0.0f;
+
+	// Solver values
+	unsigned int indexA, indexB;
+	glm::vec2 rA, rB;
+	glm::vec2 axis;
+	float mass;
+	float stretch; // At start of step, it's updated with body deltas during substeps
+	float biasRate, massScale, impulseScale;
+};
+
+// Lets body B slide along axis fixed to body A. Relative rotation is locked
+struct PrismaticJoint
+{
+	RigidBody* bodyA;
+	RigidBody* bodyB;
+	glm::vec2 localAnchorA, localAnchorB;
+	glm::vec2 localAxisA;
+	float referenceAngle;
+
+	glm::vec2 impulse = glm::vec2(0.0f); // Perpendicular to axis and angular
+
+	// Solver values
+	unsigned int indexA, indexB;
+	glm::vec2 perpendicular;
+	float s1, s2; // Angular parts of perpendicular row
+	glm::mat2 mass;
+	glm::vec2 bias;
+};
+
+// Locks relative position and rotation of two bodies
+struct WeldJoint
+{
+	RigidBody* bodyA;
+	RigidBody* bodyB;
+	glm::vec2 localAnchorA, localAnchorB;
+	float referenceAngle;
+
+	glm::vec3 impulse = glm::vec3(0.0f); // Linear and angular
+
+	// Solver values
+	unsigned int indexA, indexB;
+	glm::vec2 rA, rB;
+	glm::mat3 mass;
+	glm::vec3 bias;
+};
@@ -2,56 +2,766 @@
 
 #include "math.h"
 #include <iostream>
+#include <cassert>
 
 #include "Collision/Collisions.h"
 
 #include "Core/Profiler.h"
 #include "Core/CoreMath.h"
+#include "Core/ConvexDecomposition.h"
+#include "Core/SimdMath.h"
+
+#include "ThreadPool.h"
 
 void Simulation::singlePhysicsStep()
 {
-	updateConstraints();
+	if (!removedBodies.empty())
+	{
+		contactCache.removeBodies(removedBodies);
+		removedBodies.clear();
+	}
+
+	escapedBodies.resize(bodyStorage.getCountOfRanges());
+
+	switch (solverType)
+	{
+	case SolverType::DetectionPerIteration:
+		singleDetectionPerIterationStep();
+		break;
+	case SolverType::SequentialImpulse:
+	case SolverType::ColoredSequentialImpulse:
+	case SolverType::SimdSequentialImpulse:
+		singleSequentialImpulseStep();
+		break;
+	case SolverType::SoftStep:
+		singleSoftStep();
+		break;
+	case SolverType::Xpbd:
+		singleXpbdStep();
+		break;
+	case SolverType::_COUNT:
+		// Only counts solver types
+		assert(false);
+		break;
+	}
+
+	applyKillVolume();
+}
+
+void Simulation::singleDetectionPerIterationStep()
+{
+	updateConstraints(fixedTimeStep);
 	updateOrientationAndVelocity();
+	const bool jointsActive = prepareJoints(fixedTimeStep);
 
-	// Collisions
+	if (warmStarting)
 	{
-		for (unsigned int i = 0; i < iterationsToSolveCollisions; i++)
+		contactCache.beginStep();
+	}
+
+	// Collisions. Joints are solved once per iteration too, so they keep iterating after contacts are resolved
+	{
+		bool collisionsFound = true;
+		for (unsigned int i = 0; i < iterationsToSolveCollisions && (collisionsFound || jointsActive); i++)
 		{
-			detectCollisions();
+			if (jointsActive)
+			{
+				solveJointsIteration();
+			}
 
-			if (!Collisions::areAnyCollisionsFound())
+			if (collisionsFound)
 			{
-				break;
+				detectCollisions();
+				collisionsFound = Collisions::areAnyCollisionsFound();
+			}
+
+			if (!collisionsFound)
+			{
+				continue;
+			}
+
+			if (warmStarting)
+			{
+				contactCache.matchManifolds(Collisions::getManifolds());
+				warmStartContacts();
+				resolveCachedCollisionsSingleStep();
+			}
+			else
+			{
+				resolveCollisionsSingleStep();
+			}
+		}
+
+		if (warmStarting)
+		{
+			applyRestitution();
+		}
+	}
+}
+
+template<typename Func>
+void Simulation::forEachColor(Func func)
+{
+	const auto& colorOffsets = contactSolver.getColorOffsets();
+
+	// Constraints of one color don't share dynamic bodies, colors themselves go one after another. Each task gets a contiguous range of a color
+	for (size_t color = 0; color + 1 < colorOffsets.size(); color++)
+	{
+		const size_t first = colorOffsets[color];
+		const size_t last = colorOffsets[color + 1];
+		const size_t countOfRanges = (last - first + MIN_CONSTRAINTS_PER_TASK - 1) / MIN_CONSTRAINTS_PER_TASK;
+		ParallelUtils::parallelFor(0, countOfRanges, 1, [this, &func, first, last](size_t range)
+			{
+				const size_t rangeFirst = first + range * MIN_CONSTRAINTS_PER_TASK;
+				func(rangeFirst, std::min(rangeFirst + MIN_CONSTRAINTS_PER_TASK, last));
+			});
+	}
+
+	// Constraints, that didn't fit into any color
+	func(colorOffsets.back(), contactSolver.getConstraints().size());
+}
+
+void Simulation::singleSequentialImpulseStep()
+{
+	updateConstraints(fixedTimeStep);
+	integrateVelocities(fixedTimeStep);
+
+	detectCollisions();
+
+	// Broadphase skipped pairs inside woken islands, so they are detected again
+	while (wakeTouchedBodies())
+	{
+		detectCollisions();
+	}
+
+	auto& manifolds = Collisions::getManifolds();
+
+	// Only island mode solves by islands. Colored and SIMD modes need them just to put bodies to sleep
+	if (solverType == SolverType::SequentialImpulse)
+	{
+		islandBuilder.build(bodyStorage.getBodies(), manifolds, constraints);
+	}
+	else if (sleepingEnabled)
+	{
+		islandBuilder.buildBodyIslands(bodyStorage.getBodies(), manifolds, constraints);
+	}
+
+	if (warmStarting)
+	{
+		contactCache.beginStep();
+		contactCache.matchManifolds(manifolds);
+	}
+
+	contactSolver.prepare(manifolds, bodyStorage.getStates(), fixedTimeStep, warmStarting, BOUNCE_VELOCITY_THRESHOLD, materialTable);
+	jointSolver.prepare(constraints, contactSolver.getSolverBodies(), fixedTimeStep, fixedTimeStep, warmStarting);
+
+	switch (solverType)
+	{
+	case SolverType::ColoredSequentialImpulse:
+		solveContactsByColors();
+		break;
+	case SolverType::SimdSequentialImpulse:
+		solveContactsWithSimd();
+		break;
+	default:
+		solveContactsByIslands();
+		break;
+	}
+
+	contactSolver.storeVelocities(bodyStorage.getStates());
+	integratePositions(fixedTimeStep, true);
+
+	updateSleeping(fixedTimeStep);
+}
+
+void Simulation::singleSoftStep()
+{
+	const float timeStep = softStepTimeStep;
+	const float substepTime = timeStep / substepCount;
+
+	updateConstraints(timeStep);
+
+	updateSpeculativeDistances(timeStep);
+	detectCollisions();
+
+	// Broadphase skipped pairs inside woken islands, so they are detected again
+	while (wakeTouchedBodies())
+	{
+		updateSpeculativeDistances(timeStep);
+		detectCollisions();
+	}
+
+	auto& manifolds = Collisions::getManifolds();
+	islandBuilder.build(bodyStorage.getBodies(), manifolds, constraints);
+
+	if (warmStarting)
+	{
+		contactCache.beginStep();
+		contactCache.matchManifolds(manifolds);
+	}
+
+	contactSolver.prepare(manifolds, bodyStorage.getStates(), substepTime, warmStarting, BOUNCE_VELOCITY_THRESHOLD, materialTable);
+	jointSolver.prepare(constraints, contactSolver.getSolverBodies(), timeStep, substepTime, warmStarting);
+	contactSolver.beginSubstepping(substepTime);
+
+	// Islands don't share dynamic bodies, so each one runs all of its substeps on its own worker
+	const auto& islands = islandBuilder.getIslands();
+	{
+		PROFILE_SCOPE("Substeps");
+
+		ParallelUtils::parallelFor(0, islands.size(), MIN_ISLANDS_PER_TASK, [this, &islands, substepTime](size_t i)
+			{
+				solveIslandSubsteps(islands[i], substepTime);
+			});
+	}
+
+	contactSolver.finishSubstepping(bodyStorage.getBodies());
+	findEscapedBodies();
+
+	updateSleeping(timeStep);
+}
+
+void Simulation::singleXpbdStep()
+{
+	const float timeStep = softStepTimeStep;
+
+	constraints.updateAngularVelocityConstraints();
+
+	updateSpeculativeDistances(timeStep);
+	detectCollisions();
+
+	// Broadphase skipped pairs inside woken islands, so they are detected again
+	while (wakeTouchedBodies())
+	{
+		updateSpeculativeDistances(timeStep);
+		detectCollisions();
+	}
+
+	auto& manifolds = Collisions::getManifolds();
+	islandBuilder.build(bodyStorage.getBodies(), manifolds, constraints);
+
+	xpbdSolver.prepare(manifolds, bodyStorage.getBodies(), constraints, islandBuilder.getIslands(), materialTable, BOUNCE_VELOCITY_THRESHOLD);
+
+	// Same as soft step, each island runs all of its substeps on its own worker
+	const auto& islands = islandBuilder.getIslands();
+	{
+		PROFILE_SCOPE("Substeps");
+
+		const glm::vec2 acceleration(0.0f, gravity);
+		ParallelUtils::parallelFor(0, islands.size(), MIN_ISLANDS_PER_TASK, [this, &islands, &acceleration, timeStep](size_t i)
+			{
+				xpbdSolver.solveIsland(islands[i], i, islandBuilder.getIslandBodies(), islandBuilder.getIslandJoints(), acceleration, timeStep, substepCount);
+			});
+	}
+
+	xpbdSolver.finish(bodyStorage.getBodies());
+	findEscapedBodies();
+
+	updateSleeping(timeStep);
+}
+
+void Simulation::updateSpeculativeDistances(float timeStep)
+{
+	// Collisions are detected once per step, so each body looks as far ahead, as it can move until next detection
+	for (RigidBody* body : bodyStorage.getBodies())
+	{
+		float distance = body->isAwake() ? SOFT_STEP_SPECULATIVE_DISTANCE + glm::length(body->getVelocity()) * timeStep : 0.0f;
+		body->setSpeculativeDistance(distance);
+	}
+}
+
+void Simulation::solveIslandSubsteps(const Island& island, float substepTime)
+{
+	const auto& islandBodies = islandBuilder.getIslandBodies();
+	auto& solverBodies = contactSolver.getSolverBodies();
+	const size_t firstBody = island.firstBody;
+	const size_t lastBody = firstBody + island.countOfBodies;
+	const size_t first = island.firstManifold;
+	const size_t last = first + island.countOfManifolds;
+	const auto& islandJoints = islandBuilder.getIslandJoints();
+	const size_t firstJoint = island.firstJoint;
+	const size_t lastJoint = firstJoint + island.countOfJoints;
+
+	const glm::vec2 acceleration(0.0f, gravity);
+
+	for (unsigned int substep = 0; substep < substepCount; substep++)
+	{
+		for (size_t i = firstBody; i < lastBody; i++)
+		{
+			solverBodies[islandBodies[i]->bodyIndex].velocity += acceleration * substepTime;
+		}
+
+		// Impulses are accumulated per substep, so each substep starts from previous one's result
+		if (warmStarting || substep > 0)
+		{
+			jointSolver.warmStart(islandJoints, firstJoint, lastJoint);
+			contactSolver.warmStart(first, last);
+		}
+
+		jointSolver.solveVelocities(islandJoints, firstJoint, lastJoint, true);
+		contactSolver.solveSoft(first, last, true);
+
+		for (size_t i = firstBody; i < lastBody; i++)
+		{
+			SolverBody& body = solverBodies[islandBodies[i]->bodyIndex];
+			body.deltaPosition += body.velocity * substepTime;
+			body.deltaRotation += body.angularVelocity * substepTime;
+		}
+
+		jointSolver.solveVelocities(islandJoints, firstJoint, lastJoint, false);
+		contactSolver.solveSoft(first, last, false);
+	}
+
+	contactSolver.applyRestitution(first, last);
+	contactSolver.storeImpulses(first, last);
+}
+
+float Simulation::getStepTime() const
+{
+	return solverType == SolverType::SoftStep || solverType == SolverType::Xpbd ? softStepTimeStep : fixedTimeStep;
+}
+
+void Simulation::solveContactsByIslands()
+{
+	// Islands don't share dynamic bodies, so each one is solved on its own worker
+	const auto& islands = islandBuilder.getIslands();
+
+	{
+		PROFILE_SCOPE("Island Iterations");
+
+		ParallelUtils::parallelFor(0, islands.size(), MIN_ISLANDS_PER_TASK, [this, &islands](size_t i)
+			{
+				solveIslandVelocities(islands[i]);
+				solveIslandPositions(islands[i]);
+			});
+	}
+}
+
+void Simulation::solveContactsByColors()
+{
+	contactSolver.colorConstraints(bodyStorage.size());
+
+	// Velocities
+	{
+		PROFILE_SCOPE("Velocity Iterations");
+
+		// Joints aren't colored, they are few, so they are solved serially before colors
+		const auto& joints = jointSolver.getActiveJoints();
+		if (warmStarting)
+		{
+			jointSolver.warmStart(joints, 0, joints.size());
+			forEachColor([this](size_t first, size_t last) { contactSolver.warmStart(first, last); });
+		}
+
+		for (unsigned int i = 0; i < blockSolverIterations; i++)
+		{
+			jointSolver.solveVelocities(joints, 0, joints.size(), true);
+			forEachColor([this](size_t first, size_t last) { contactSolver.solveVelocities(first, last); });
+		}
+
+		forEachColor([this](size_t first, size_t last) { contactSolver.applyRestitution(first, last); });
+		contactSolver.storeImpulses(0, contactSolver.getConstraints().size());
+	}
+
+	// Positions
+	{
+		PROFILE_SCOPE("Position Iterations");
+
+		for (unsigned int i = 0; i < positionIterations; i++)
+		{
+			forEachColor([this](size_t first, size_t last) { contactSolver.solvePseudoVelocities(first, last); });
+		}
+	}
+}
+
+void Simulation::solveContactsWithSimd()
+{
+	const size_t count = contactSolver.getConstraints().size();
+
+	// Velocities
+	{
+		PROFILE_SCOPE("Velocity Iterations");
+
+		// Warm starting and restitution run once per step, so they stay scalar
+		const auto& joints = jointSolver.getActiveJoints();
+		if (warmStarting)
+		{
+			jointSolver.warmStart(joints, 0, joints.size());
+			contactSolver.warmStart(0, count);
+		}
+
+		// SIMD solver works on its own copy of bodies. Joints are solved on solver bodies, so velocities of their bodies are passed back and forth
+		auto& solverBodies = contactSolver.getSolverBodies();
+		const auto& jointBodies = jointSolver.getActiveBodies();
+		simdContactSolver.build(contactSolver.getConstraints(), solverBodies);
+		for (unsigned int i = 0; i < iterationsToSolveCollisions; i++)
+		{
+			if (!joints.empty())
+			{
+				simdContactSolver.storeVelocities(solverBodies, jointBodies);
+				jointSolver.solveVelocities(joints, 0, joints.size(), true);
+				simdContactSolver.loadVelocities(solverBodies, jointBodies);
 			}
+			simdContactSolver.solveVelocities();
+		}
+		simdContactSolver.finish(solverBodies);
+
+		contactSolver.applyRestitution(0, count);
+		contactSolver.storeImpulses(0, count);
+	}
+
+	// Positions
+	{
+		PROFILE_SCOPE("Position Iterations");
 
-			resolveCollisionsSingleStep();
+		for (unsigned int i = 0; i < positionIterations; i++)
+		{
+			contactSolver.solvePseudoVelocities(0, count);
 		}
 	}
 }
 
+void Simulation::solveIslandVelocities(const Island& island)
+{
+	size_t first = island.firstManifold;
+	size_t last = first + island.countOfManifolds;
+	const auto& islandJoints = islandBuilder.getIslandJoints();
+	size_t firstJoint = island.firstJoint;
+	size_t lastJoint = firstJoint + island.countOfJoints;
+	if (first == last && firstJoint == lastJoint)
+	{
+		return;
+	}
+
+	if (warmStarting)
+	{
+		jointSolver.warmStart(islandJoints, firstJoint, lastJoint);
+		contactSolver.warmStart(first, last);
+	}
+
+	for (unsigned int i = 0; i < blockSolverIterations; i++)
+	{
+		jointSolver.solveVelocities(islandJoints, firstJoint, lastJoint, true);
+		contactSolver.solveVelocities(first, last);
+	}
+
+	contactSolver.applyRestitution(first, last);
+	contactSolver.storeImpulses(first, last);
+}
+
+void Simulation::solveIslandPositions(const Island& island)
+{
+	size_t first = island.firstManifold;
+	size_t last = first + island.countOfManifolds;
+
+	for (unsigned int i = 0; i < positionIterations && first != last; i++)
+	{
+		contactSolver.solvePseudoVelocities(first, last);
+	}
+}
+
 void Simulation::updateOrientationAndVelocity()
 {
-	glm::vec2 acceleration(0.0f, gravity);
-	for (auto& body : bodies)
+	integrateVelocities(fixedTimeStep);
+	integratePositions(fixedTimeStep, false);
+}
+
+bool Simulation::prepareJoints(float timeStep)
+{
+	// Contacts of this mode are solved directly on bodies, so joints get their own solver bodies
+	if (constraints.getCountOfJoints() == 0)
 	{
-		if (body->isStatic())
+		return false;
+	}
+
+	auto& states = bodyStorage.getStates();
+	contactSolver.gatherBodies(states);
+	jointSolver.prepare(constraints, contactSolver.getSolverBodies(), timeStep, timeStep, warmStarting);
+
+	const auto& joints = jointSolver.getActiveJoints();
+	if (warmStarting)
+	{
+		jointSolver.warmStart(joints, 0, joints.size());
+		contactSolver.storeVelocities(states, jointSolver.getActiveBodies());
+	}
+	return !joints.empty();
+}
+
+void Simulation::solveJointsIteration()
+{
+	// Contacts between iterations changed bodies, so only bodies of joints are synced with solver bodies
+	auto& states = bodyStorage.getStates();
+	const auto& joints = jointSolver.getActiveJoints();
+	contactSolver.gatherVelocities(states, jointSolver.getActiveBodies());
+	jointSolver.solveVelocities(joints, 0, joints.size(), true);
+	contactSolver.storeVelocities(states, jointSolver.getActiveBodies());
+}
+
+void Simulation::integrateVelocities(float timeStep)
+{
+	PROFILE_FUNCTION();
+
+	BodyStates& states = bodyStorage.getStates();
+	const glm::vec2 deltaVelocity = glm::vec2(0.0f, gravity) * timeStep;
+
+	// Only awake bodies are accelerated. Awake flag is used as a factor, so loop has no branches
+	bodyStorage.forEachRange([&states, &deltaVelocity](size_t, size_t first, size_t last)
+		{
+			SimdMath::addScaledVector(states.velocities.data() + first, states.awake.data() + first, deltaVelocity, last - first);
+		});
+}
+
+void Simulation::integratePositions(float timeStep, bool withPseudoVelocities)
+{
+	PROFILE_FUNCTION();
+
+	const auto& bodies = bodyStorage.getBodies();
+	BodyStates& states = bodyStorage.getStates();
+	const glm::vec2* pseudoVelocities = contactSolver.getPseudoVelocities().data();
+	const float* pseudoAngularVelocities = contactSolver.getPseudoAngularVelocities().data();
+
+	// Transforms of each range are refreshed and checked against kill volume right after integration, while its bodies are still in cache
+	bodyStorage.forEachRange([&](size_t range, size_t first, size_t last)
+		{
+			const float* awake = states.awake.data() + first;
+			const size_t count = last - first;
+
+			// Separation is applied together with regular motion, so each body is moved once per step
+			if (withPseudoVelocities)
+			{
+				SimdMath::addScaledSum(states.positions.data() + first, states.velocities.data() + first, pseudoVelocities + first, awake, timeStep, count);
+				SimdMath::addScaledSum(states.rotations.data() + first, states.angularVelocities.data() + first, pseudoAngularVelocities + first, awake, timeStep, count);
+			}
+			else
+			{
+				SimdMath::addScaled(states.positions.data() + first, states.velocities.data() + first, awake, timeStep, count);
+				SimdMath::addScaled(states.rotations.data() + first, states.angularVelocities.data() + first, awake, timeStep, count);
+			}
+
+			for (size_t i = first; i < last; i++)
+			{
+				if (states.awake[i] != 0.0f)
+				{
+					bodies[i]->markMoved();
+				}
+			}
+
+			bodyStorage.updateTransforms(first, last);
+			findEscapedBodies(range, first, last);
+		});
+}
+
+void Simulation::updateConstraints(float timeStep)
+{
+	PROFILE_FUNCTION();
+
+	constraints.update(timeStep);
+}
+
+bool Simulation::wakeTouchedBodies()
+{
+	bool anyWoken = false;
+
+	// Broadphase skips pairs of resting bodies, so every sleeping body here is touched by an awake one
+	for (const auto& manifold : Collisions::getManifolds())
+	{
+		if (manifold.bodyA->isSleeping())
+		{
+			wakeUpIsland(manifold.bodyA);
+			anyWoken = true;
+		}
+		if (manifold.bodyB->isSleeping())
+		{
+			wakeUpIsland(manifold.bodyB);
+			anyWoken = true;
+		}
+	}
+
+	// Joint doesn't let one of its bodies move alone
+	constraints.forEachJoint([this, &anyWoken](ConstraintId, RigidBody* bodyA, RigidBody* bodyB)
+		{
+			if (bodyA->isSleeping() && bodyB->isAwake())
+			{
+				wakeUpIsland(bodyA);
+				anyWoken = true;
+			}
+			else if (bodyB->isSleeping() && bodyA->isAwake())
+			{
+				wakeUpIsland(bodyB);
+				anyWoken = true;
+			}
+		});
+
+	return anyWoken;
+}
+
+void Simulation::wakeUpIsland(RigidBody* body)
+{
+	// Bodies fell asleep together, so none of them is left hanging on a sleeping neighbour
+	if (const SleepingIsland* island = sleepingIslands.find(body->sleepingIsland))
+	{
+		for (BodyHandle otherHandle : island->bodies)
+		{
+			RigidBody* other = bodyStorage.getBody(otherHandle);
+			if (other && other->isSleeping())
+			{
+				other->wakeUp();
+			}
+		}
+		sleepingIslands.remove(body->sleepingIsland);
+	}
+
+	if (body->isSleeping())
+	{
+		body->wakeUp();
+	}
+}
+
+void Simulation::updateSleeping(float timeStep)
+{
+	if (!sleepingEnabled)
+	{
+		return;
+	}
+
+	PROFILE_FUNCTION();
+
+	const float linearSq = SLEEP_LINEAR_VELOCITY * SLEEP_LINEAR_VELOCITY;
+	const auto& islandBodies = islandBuilder.getIslandBodies();
+
+	for (const auto& island : islandBuilder.getIslands())
+	{
+		// Island sleeps only as a whole, otherwise its awake bodies would sink into sleeping ones
+		float minSleepTime = TIME_TO_SLEEP;
+		for (size_t i = island.firstBody; i < island.firstBody + island.countOfBodies; i++)
+		{
+			RigidBody* body = islandBodies[i];
+
+			// Woken body's sleeping neighbours are woken by its contacts, so their sleeping island is forgotten
+			sleepingIslands.remove(body->sleepingIsland);
+
+			if (glm::dot(body->getVelocity(), body->getVelocity()) > linearSq || fabsf(body->getAngularVelocity()) > SLEEP_ANGULAR_VELOCITY)
+			{
+				body->sleepTime = 0.0f;
+			}
+			else
+			{
+				body->sleepTime += timeStep;
+			}
+			minSleepTime = std::min(minSleepTime, body->sleepTime);
+		}
+
+		if (minSleepTime < TIME_TO_SLEEP)
 		{
 			continue;
 		}
 
-		// Update orientation and velocity
-		body->velocity += acceleration * fixedTimeStep;
-		body->moveAndRotate(body->velocity * fixedTimeStep, body->angularVelocity * fixedTimeStep);
+		SleepingIsland sleepingIsland;
+		for (size_t i = island.firstBody; i < island.firstBody + island.countOfBodies; i++)
+		{
+			sleepingIsland.bodies.push_back(islandBodies[i]->handle);
+		}
+
+		const Handle<SleepingIsland> handle = sleepingIslands.add(sleepingIsland);
+		for (size_t i = island.firstBody; i < island.firstBody + island.countOfBodies; i++)
+		{
+			islandBodies[i]->sleep();
+			islandBodies[i]->sleepingIsland = handle;
+		}
+	}
+}
+
+void Simulation::updateTransforms()
+{
+	PROFILE_FUNCTION();
+
+	dirtyBodies.clear();
+	dirtyRotations.clear();
+	for (RigidBody* body : bodyStorage.getBodies())
+	{
+		if (body->shapeType != ShapeType::Circle && body->isTransformUpdateRequired())
+		{
+			dirtyBodies.push_back(body);
+			dirtyRotations.push_back(body->getRotation());
+		}
+	}
+
+	size_t count = dirtyBodies.size();
+	dirtyCosSin.resize(count);
+	SimdMath::cosSin(dirtyRotations.data(), dirtyCosSin.data(), count);
+
+	// Each body writes only its own vertices, so bodies can be processed in parallel
+	ParallelUtils::parallelFor(0, count, 256, [this](size_t i)
+		{
+			RigidBody* body = dirtyBodies[i];
+			if (body->shapeType == ShapeType::Polygon)
+			{
+				static_cast<RigidPolygon*>(body)->updateTransform(dirtyCosSin[i]);
+			}
+			else
+			{
+				static_cast<RigidCompound*>(body)->updateTransform(dirtyCosSin[i]);
+			}
+		});
+}
+
+void Simulation::findEscapedBodies()
+{
+	// Substepping solvers write bodies back serially, so ranges are checked in a pass of their own
+	bodyStorage.forEachRange([this](size_t range, size_t first, size_t last)
+		{
+			findEscapedBodies(range, first, last);
+		});
+}
+
+void Simulation::findEscapedBodies(size_t range, size_t first, size_t last)
+{
+	if (killVolume.policy == KillVolumePolicy::None)
+	{
+		return;
+	}
+
+	// Static and sleeping bodies don't move, so only awake ones can leave
+	const auto& bodies = bodyStorage.getBodies();
+	const BodyStates& states = bodyStorage.getStates();
+	for (size_t i = first; i < last; i++)
+	{
+		if (states.awake[i] != 0.0f && !killVolume.bounds.contains(states.positions[i]))
+		{
+			escapedBodies[range].push_back(bodies[i]);
+		}
 	}
 }
 
-void Simulation::updateConstraints()
+void Simulation::applyKillVolume()
 {
 	PROFILE_FUNCTION();
 
-	for (auto& constraint : constraints)
+	// Bodies are stored by pointer, so removing one doesn't disturb the rest
+	for (auto& escaped : escapedBodies)
 	{
-		constraint->update(fixedTimeStep);
+		for (RigidBody* body : escaped)
+		{
+			killVolumeEvents.push_back({ body->handle, body->getPosition(), body->getVelocity(), killVolume.policy });
+
+			switch (killVolume.policy)
+			{
+			case KillVolumePolicy::Remove:
+				removeBody(body->handle);
+				break;
+			case KillVolumePolicy::Sleep:
+				body->sleep();
+				break;
+			case KillVolumePolicy::Teleport:
+				body->setVelocity(glm::vec2(0.0f));
+				body->setAngularVelocity(0.0f);
+				body->move(killVolume.teleportPosition - body->getPosition());
+				break;
+			case KillVolumePolicy::None:
+				break;
+			}
+		}
+		escaped.clear();
 	}
 }
 
@@ -59,6 +769,9 @@ void Simulation::detectCollisions()
 {
 	Collisions::clearManifolds();
 
+	// Narrowphase reads only precomputed vertices after that
+	updateTransforms();
+
 	switch (collisionMethod)
 	{
 	case CollisionDetectionMethod::BruteForce:
@@ -75,6 +788,7 @@ void Simulation::detectCollisions()
 
 void Simulation::detectCollisionsBruteForce()
 {
+	const auto& bodies = bodyStorage.getBodies();
 	size_t count = bodies.size();
 	if (count < 2)
 	{
@@ -85,16 +799,16 @@ void Simulation::detectCollisionsBruteForce()
 
 	for (size_t i = 0; i < count - 1; i++)
 	{
-		auto& bodyA = bodies[i];
-		const bool isBodyAStatic = bodyA->isStatic();
+		RigidBody* bodyA = bodies[i];
+		const bool isBodyAAwake = bodyA->isAwake();
 		const AABB& bodyA_AABB = bodyA->getAABB_noUpdate();
 
 		for (size_t j = i + 1; j < count; j++)
 		{
-			auto& bodyB = bodies[j];
-			const bool isBodyBStatic = bodyB->isStatic();
+			RigidBody* bodyB = bodies[j];
+			const bool isBodyBAwake = bodyB->isAwake();
 
-			if (isBodyAStatic && isBodyBStatic)
+			if (!isBodyAAwake && !isBodyBAwake)
 			{
 				continue;
 			}
@@ -113,7 +827,7 @@ void Simulation::detectCollisionsBruteForce()
 void Simulation::detectCollisionsWithQuadtree()
 {
 	// Rebuild quadtree with current body positions
-	quadtree->rebuild(bodies);
+	quadtree->rebuild(bodyStorage.getBodies());
 
 	// Get potential collision pairs from quadtree
 	static std::vector<RigidBodyPair> pairs;
@@ -136,7 +850,7 @@ void Simulation::detectCollisionsWithQuadtree()
 void Simulation::detectCollisionsWithHashGrid()
 {
 	// Rebuild hash grid with current body positions
-	spatialHashGrid->rebuild(bodies);
+	spatialHashGrid->rebuild(bodyStorage.getBodies());
 
 	// Get potential collision pairs from hash grid
 	static std::vector<RigidBodyPair> pairs;
@@ -147,11 +861,81 @@ void Simulation::detectCollisionsWithHashGrid()
 	{
 		PROFILE_SCOPE("Hash Grid Narrow Phase");
 
-		for (const auto& pair : pairs)
-		{
-			RigidBody* body1 = pair.first;
-			RigidBody* body2 = pair.second;
-			Collisions::checkCollision(body1, body2);
+		for (const auto& pair : pairs)
+		{
+			RigidBody* body1 = pair.first;
+			RigidBody* body2 = pair.second;
+			Collisions::checkCollision(body1, body2);
+		}
+	}
+}
+
+void Simulation::warmStartContacts()
+{
+	const auto& manifolds = Collisions::getManifolds();
+
+	// Remember, how fast contacts were approaching, before any impulses of this step
+	for (const auto& manifold : manifolds)
+	{
+		RigidBody* body1 = manifold.bodyA;
+		RigidBody* body2 = manifold.bodyB;
+
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
+		{
+			CachedContact* cached = manifold.cachedContacts[i];
+			if (cached->isPrepared)
+			{
+				continue;
+			}
+
+			glm::vec2 r1 = manifold.contacts[i] - body1->getCenterOfMass();
+			glm::vec2 r2 = manifold.contacts[i] - body2->getCenterOfMass();
+
+			glm::vec2 r1Perp = glm::vec2(-r1.y, r1.x);
+			glm::vec2 r2Perp = glm::vec2(-r2.y, r2.x);
+
+			glm::vec2 relativeVelocity = (body2->getVelocity() + r2Perp * body2->getAngularVelocity()) - (body1->getVelocity() + r1Perp * body1->getAngularVelocity());
+			cached->approachVelocity = glm::dot(relativeVelocity, manifold.normal);
+		}
+	}
+
+	// Contacts start with impulses, that they ended previous step with. Each cached contact is warm started once per step
+	for (const auto& manifold : manifolds)
+	{
+		RigidBody* body1 = manifold.bodyA;
+		RigidBody* body2 = manifold.bodyB;
+
+		const glm::vec2& centerOfMass1 = body1->getCenterOfMass();
+		const glm::vec2& centerOfMass2 = body2->getCenterOfMass();
+
+		const glm::vec2 tangent = glm::vec2(-manifold.normal.y, manifold.normal.x);
+
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
+		{
+			CachedContact* cached = manifold.cachedContacts[i];
+			if (cached->isPrepared)
+			{
+				continue;
+			}
+			cached->isPrepared = true;
+
+			const glm::vec2& contact = manifold.contacts[i];
+			glm::vec2 r1 = contact - centerOfMass1;
+			glm::vec2 r2 = contact - centerOfMass2;
+
+			glm::vec2 r1Perp = glm::vec2(-r1.y, r1.x);
+			glm::vec2 r2Perp = glm::vec2(-r2.y, r2.x);
+
+			glm::vec2 impulse = manifold.normal * cached->previousNormalImpulse + tangent * cached->previousTangentImpulse;
+
+			body1->setVelocity(body1->getVelocity() - impulse * body1->getInvMass());
+			body1->setAngularVelocity(body1->getAngularVelocity() - glm::dot(r1Perp, impulse) * body1->getInvInertia());
+
+			body2->setVelocity(body2->getVelocity() + impulse * body2->getInvMass());
+			body2->setAngularVelocity(body2->getAngularVelocity() + glm::dot(r2Perp, impulse) * body2->getInvInertia());
+
+			cached->normalImpulse += cached->previousNormalImpulse;
+			cached->tangentImpulse += cached->previousTangentImpulse;
 		}
 	}
 }
@@ -166,10 +950,11 @@ void Simulation::resolveCollisionsSingleStep()
 		RigidBody* body2 = manifold.bodyB;
 
 		// Cache frequently used values
-		const float elasticityPlusOne = 1.0f + fmaxf(body1->material->elasticity, body2->material->elasticity);
-		const float staticFriction = (body1->material->staticFriction + body2->material->staticFriction) * 0.5f;
-		const float dynamicFriction = (body1->material->dynamicFriction + body2->material->dynamicFriction) * 0.5f;
-		const float invMassSum = body1->invMass + body2->invMass;
+		const MaterialPair& materials = materialTable.getPair(body1->material, body2->material);
+		const float elasticityPlusOne = 1.0f + materials.elasticity;
+		const float staticFriction = materials.staticFriction;
+		const float dynamicFriction = materials.dynamicFriction;
+		const float invMassSum = body1->getInvMass() + body2->getInvMass();
 
 		const glm::vec2& centerOfMass1 = body1->getCenterOfMass();
 		const glm::vec2& centerOfMass2 = body2->getCenterOfMass();
@@ -192,10 +977,10 @@ void Simulation::resolveCollisionsSingleStep()
 			glm::vec2 r1Perp = glm::vec2(-r1.y, r1.x);
 			glm::vec2 r2Perp = glm::vec2(-r2.y, r2.x);
 
-			glm::vec2 angularLinearVelocity1 = r1Perp * body1->angularVelocity;
-			glm::vec2 angularLinearVelocity2 = r2Perp * body2->angularVelocity;
+			glm::vec2 angularLinearVelocity1 = r1Perp * body1->getAngularVelocity();
+			glm::vec2 angularLinearVelocity2 = r2Perp * body2->getAngularVelocity();
 
-			glm::vec2 relativeVelocity = (body2->velocity + angularLinearVelocity2) - (body1->velocity + angularLinearVelocity1);
+			glm::vec2 relativeVelocity = (body2->getVelocity() + angularLinearVelocity2) - (body1->getVelocity() + angularLinearVelocity1);
 
 			float velAlongNormal = glm::dot(relativeVelocity, manifold.normal);
 			if (velAlongNormal > 0.0f)
@@ -206,8 +991,8 @@ void Simulation::resolveCollisionsSingleStep()
 			float r1PerpDotN = glm::dot(r1Perp, manifold.normal);
 			float r2PerpDotN = glm::dot(r2Perp, manifold.normal);
 
-			float inertia1_ = r1PerpDotN * r1PerpDotN * body1->invInertia;
-			float inertia2_ = r2PerpDotN * r2PerpDotN * body2->invInertia;
+			float inertia1_ = r1PerpDotN * r1PerpDotN * body1->getInvInertia();
+			float inertia2_ = r2PerpDotN * r2PerpDotN * body2->getInvInertia();
 
 			float denom = invMassSum + inertia1_ + inertia2_;
 			float jn = -elasticityPlusOne * velAlongNormal / denom;
@@ -226,11 +1011,11 @@ void Simulation::resolveCollisionsSingleStep()
 			const glm::vec2& r1Perp = perpR1Array[i];
 			const glm::vec2& r2Perp = perpR2Array[i];
 
-			body1->velocity -= impulse * body1->invMass;
-			body1->angularVelocity -= glm::dot(r1Perp, impulse) * body1->invInertia;
+			body1->setVelocity(body1->getVelocity() - impulse * body1->getInvMass());
+			body1->setAngularVelocity(body1->getAngularVelocity() - glm::dot(r1Perp, impulse) * body1->getInvInertia());
 
-			body2->velocity += impulse * body2->invMass;
-			body2->angularVelocity += glm::dot(r2Perp, impulse) * body2->invInertia;
+			body2->setVelocity(body2->getVelocity() + impulse * body2->getInvMass());
+			body2->setAngularVelocity(body2->getAngularVelocity() + glm::dot(r2Perp, impulse) * body2->getInvInertia());
 		}
 
 		// Calculate friction impulses
@@ -239,10 +1024,10 @@ void Simulation::resolveCollisionsSingleStep()
 			glm::vec2 r1Perp = perpR1Array[i];
 			glm::vec2 r2Perp = perpR2Array[i];
 
-			glm::vec2 angularLinearVelocity1 = r1Perp * body1->angularVelocity;
-			glm::vec2 angularLinearVelocity2 = r2Perp * body2->angularVelocity;
+			glm::vec2 angularLinearVelocity1 = r1Perp * body1->getAngularVelocity();
+			glm::vec2 angularLinearVelocity2 = r2Perp * body2->getAngularVelocity();
 
-			glm::vec2 relativeVelocity = (body2->velocity + angularLinearVelocity2) - (body1->velocity + angularLinearVelocity1);
+			glm::vec2 relativeVelocity = (body2->getVelocity() + angularLinearVelocity2) - (body1->getVelocity() + angularLinearVelocity1);
 
 			glm::vec2 tangent = relativeVelocity - glm::dot(relativeVelocity, manifold.normal) * manifold.normal;
 			if (glm::dot(tangent, tangent) < 1e-16f)
@@ -256,8 +1041,8 @@ void Simulation::resolveCollisionsSingleStep()
 			float r1PerpDotT = glm::dot(r1Perp, tangent);
 			float r2PerpDotT = glm::dot(r2Perp, tangent);
 
-			float inertia1_ = r1PerpDotT * r1PerpDotT * body1->invInertia;
-			float inertia2_ = r2PerpDotT * r2PerpDotT * body2->invInertia;
+			float inertia1_ = r1PerpDotT * r1PerpDotT * body1->getInvInertia();
+			float inertia2_ = r2PerpDotT * r2PerpDotT * body2->getInvInertia();
 
 			float denom = invMassSum + inertia1_ + inertia2_;
 			float jt = -glm::dot(relativeVelocity, tangent) / denom;
@@ -281,60 +1066,249 @@ void Simulation::resolveCollisionsSingleStep()
 			const auto& r1Perp = perpR1Array[i];
 			const auto& r2Perp = perpR2Array[i];
 
-			body1->velocity -= impulse * body1->invMass;
-			body1->angularVelocity -= glm::dot(r1Perp, impulse) * body1->invInertia;
+			body1->setVelocity(body1->getVelocity() - impulse * body1->getInvMass());
+			body1->setAngularVelocity(body1->getAngularVelocity() - glm::dot(r1Perp, impulse) * body1->getInvInertia());
 
-			body2->velocity += impulse * body2->invMass;
-			body2->angularVelocity += glm::dot(r2Perp, impulse) * body2->invInertia;
+			body2->setVelocity(body2->getVelocity() + impulse * body2->getInvMass());
+			body2->setAngularVelocity(body2->getAngularVelocity() + glm::dot(r2Perp, impulse) * body2->getInvInertia());
 		}
-	
-		// Separate bodies
-		const float percent = 0.8f;
-		const float slop = 0.05f * 0.01f;
 
-		glm::vec2 displacement = manifold.normal * (percent * fmax(manifold.depth - slop, 0.0f));
+		separateBodies(manifold);
+	}
+}
+
+void Simulation::resolveCachedCollisionsSingleStep()
+{
+	// Same as resolveCollisionsSingleStep, but impulses are accumulated per contact and clamped by total,
+	// so warm started impulse can be taken back, if it was too big
+	const auto& manifolds = Collisions::getManifolds();
+	for (auto& manifold : manifolds)
+	{
+		RigidBody* body1 = manifold.bodyA;
+		RigidBody* body2 = manifold.bodyB;
+
+		// Cache frequently used values
+		const MaterialPair& materials = materialTable.getPair(body1->material, body2->material);
+		const float staticFriction = materials.staticFriction;
+		const float dynamicFriction = materials.dynamicFriction;
+		const float invMassSum = body1->getInvMass() + body2->getInvMass();
+
+		const glm::vec2& centerOfMass1 = body1->getCenterOfMass();
+		const glm::vec2& centerOfMass2 = body2->getCenterOfMass();
+
+		const glm::vec2 tangent = glm::vec2(-manifold.normal.y, manifold.normal.x);
+		const float contactsCount = (float)manifold.countOfContacts;
+
+		//
+		glm::vec2 perpR1Array[2];
+		glm::vec2 perpR2Array[2];
+		float impulses[2];
 
-		if (body1->isStatic())
+		// Calculate collision impulses
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
 		{
-			body2->move(displacement);
+			const glm::vec2& contact = manifold.contacts[i];
+
+			glm::vec2 r1 = contact - centerOfMass1;
+			glm::vec2 r2 = contact - centerOfMass2;
+
+			glm::vec2 r1Perp = glm::vec2(-r1.y, r1.x);
+			glm::vec2 r2Perp = glm::vec2(-r2.y, r2.x);
+
+			glm::vec2 relativeVelocity = (body2->getVelocity() + r2Perp * body2->getAngularVelocity()) - (body1->getVelocity() + r1Perp * body1->getAngularVelocity());
+			float velAlongNormal = glm::dot(relativeVelocity, manifold.normal);
+
+			float r1PerpDotN = glm::dot(r1Perp, manifold.normal);
+			float r2PerpDotN = glm::dot(r2Perp, manifold.normal);
+
+			float denom = invMassSum + r1PerpDotN * r1PerpDotN * body1->getInvInertia() + r2PerpDotN * r2PerpDotN * body2->getInvInertia();
+			float jn = -velAlongNormal / (denom * contactsCount);
+
+			// Total impulse can only push bodies apart
+			CachedContact* cached = manifold.cachedContacts[i];
+			float oldImpulse = cached->normalImpulse;
+			cached->normalImpulse = fmaxf(oldImpulse + jn, 0.0f);
+
+			impulses[i] = cached->normalImpulse - oldImpulse;
+			perpR1Array[i] = r1Perp;
+			perpR2Array[i] = r2Perp;
 		}
-		else if (body2->isStatic())
+
+		// Apply collision impulses
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
 		{
-			body1->move(-displacement);
+			const glm::vec2 impulse = impulses[i] * manifold.normal;
+			const glm::vec2& r1Perp = perpR1Array[i];
+			const glm::vec2& r2Perp = perpR2Array[i];
+
+			body1->setVelocity(body1->getVelocity() - impulse * body1->getInvMass());
+			body1->setAngularVelocity(body1->getAngularVelocity() - glm::dot(r1Perp, impulse) * body1->getInvInertia());
+
+			body2->setVelocity(body2->getVelocity() + impulse * body2->getInvMass());
+			body2->setAngularVelocity(body2->getAngularVelocity() + glm::dot(r2Perp, impulse) * body2->getInvInertia());
 		}
-		else
+
+		// Calculate friction impulses
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
+		{
+			const glm::vec2& r1Perp = perpR1Array[i];
+			const glm::vec2& r2Perp = perpR2Array[i];
+
+			glm::vec2 relativeVelocity = (body2->getVelocity() + r2Perp * body2->getAngularVelocity()) - (body1->getVelocity() + r1Perp * body1->getAngularVelocity());
+
+			float r1PerpDotT = glm::dot(r1Perp, tangent);
+			float r2PerpDotT = glm::dot(r2Perp, tangent);
+
+			float denom = invMassSum + r1PerpDotT * r1PerpDotT * body1->getInvInertia() + r2PerpDotT * r2PerpDotT * body2->getInvInertia();
+			float jt = -glm::dot(relativeVelocity, tangent) / (denom * contactsCount);
+
+			// Static friction holds while total impulse is inside of its cone, otherwise contact slides
+			CachedContact* cached = manifold.cachedContacts[i];
+			float oldImpulse = cached->tangentImpulse;
+			float newImpulse = oldImpulse + jt;
+			if (fabsf(newImpulse) > cached->normalImpulse * staticFriction)
+			{
+				float maxFriction = cached->normalImpulse * dynamicFriction;
+				newImpulse = glm::clamp(newImpulse, -maxFriction, maxFriction);
+			}
+			cached->tangentImpulse = newImpulse;
+
+			impulses[i] = newImpulse - oldImpulse;
+		}
+
+		// Apply friction impulses
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
+		{
+			const glm::vec2 impulse = impulses[i] * tangent;
+			const glm::vec2& r1Perp = perpR1Array[i];
+			const glm::vec2& r2Perp = perpR2Array[i];
+
+			body1->setVelocity(body1->getVelocity() - impulse * body1->getInvMass());
+			body1->setAngularVelocity(body1->getAngularVelocity() - glm::dot(r1Perp, impulse) * body1->getInvInertia());
+
+			body2->setVelocity(body2->getVelocity() + impulse * body2->getInvMass());
+			body2->setAngularVelocity(body2->getAngularVelocity() + glm::dot(r2Perp, impulse) * body2->getInvInertia());
+		}
+
+		separateBodies(manifold);
+	}
+}
+
+void Simulation::applyRestitution()
+{
+	// Bounce is applied once, after contacts stopped bodies. Targeting it inside of iterations pumps energy into piles,
+	// because accumulated impulses of neighbouring contacts keep fighting each other
+	const auto& manifolds = Collisions::getManifolds();
+	for (const auto& manifold : manifolds)
+	{
+		RigidBody* body1 = manifold.bodyA;
+		RigidBody* body2 = manifold.bodyB;
+
+		const float elasticity = materialTable.getPair(body1->material, body2->material).elasticity;
+		if (elasticity == 0.0f)
+		{
+			continue;
+		}
+
+		const float invMassSum = body1->getInvMass() + body2->getInvMass();
+
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
 		{
-			float displacementRatio = body1->mass / (body1->mass + body2->mass);
-			body1->move(displacement * -(1.0f - displacementRatio));
-			body2->move(displacement * displacementRatio);
+			CachedContact* cached = manifold.cachedContacts[i];
+
+			// Slow contacts don't bounce, so resting bodies don't jitter
+			if (cached->approachVelocity > -BOUNCE_VELOCITY_THRESHOLD || cached->normalImpulse == 0.0f)
+			{
+				continue;
+			}
+
+			const glm::vec2& contact = manifold.contacts[i];
+			glm::vec2 r1 = contact - body1->getCenterOfMass();
+			glm::vec2 r2 = contact - body2->getCenterOfMass();
+
+			glm::vec2 r1Perp = glm::vec2(-r1.y, r1.x);
+			glm::vec2 r2Perp = glm::vec2(-r2.y, r2.x);
+
+			glm::vec2 relativeVelocity = (body2->getVelocity() + r2Perp * body2->getAngularVelocity()) - (body1->getVelocity() + r1Perp * body1->getAngularVelocity());
+			float velAlongNormal = glm::dot(relativeVelocity, manifold.normal);
+
+			float r1PerpDotN = glm::dot(r1Perp, manifold.normal);
+			float r2PerpDotN = glm::dot(r2Perp, manifold.normal);
+
+			float denom = invMassSum + r1PerpDotN * r1PerpDotN * body1->getInvInertia() + r2PerpDotN * r2PerpDotN * body2->getInvInertia();
+			float jn = -(velAlongNormal + elasticity * cached->approachVelocity) / denom;
+
+			float oldImpulse = cached->normalImpulse;
+			cached->normalImpulse = fmaxf(oldImpulse + jn, 0.0f);
+
+			glm::vec2 impulse = (cached->normalImpulse - oldImpulse) * manifold.normal;
+
+			body1->setVelocity(body1->getVelocity() - impulse * body1->getInvMass());
+			body1->setAngularVelocity(body1->getAngularVelocity() - glm::dot(r1Perp, impulse) * body1->getInvInertia());
+
+			body2->setVelocity(body2->getVelocity() + impulse * body2->getInvMass());
+			body2->setAngularVelocity(body2->getAngularVelocity() + glm::dot(r2Perp, impulse) * body2->getInvInertia());
 		}
 	}
 }
 
+void Simulation::separateBodies(const CollisionManifold& manifold)
+{
+	RigidBody* body1 = manifold.bodyA;
+	RigidBody* body2 = manifold.bodyB;
+
+	const float percent = 0.8f;
+	const float slop = 0.05f * 0.01f;
+
+	glm::vec2 displacement = manifold.normal * (percent * fmax(manifold.depth - slop, 0.0f));
+
+	if (body1->isStatic())
+	{
+		body2->move(displacement);
+	}
+	else if (body2->isStatic())
+	{
+		body1->move(-displacement);
+	}
+	else
+	{
+		float displacementRatio = body1->mass / (body1->mass + body2->mass);
+		body1->move(displacement * -(1.0f - displacementRatio));
+		body2->move(displacement * displacementRatio);
+	}
+}
+
 Simulation::Simulation()
 {
 	worldBounds = { glm::vec2(-WORLD_BOUNDS), glm::vec2(WORLD_BOUNDS) };
+	killVolume.bounds = worldBounds;
 
 	quadtree = std::make_unique<Quadtree>(worldBounds);
 	spatialHashGrid = std::make_unique<SpatialHashGrid>(worldBounds, 0.1f * 1.41f);
+}
 
-	bodies.reserve(100);
-	constraints.reserve(100);
+MaterialId Simulation::validateMaterial(MaterialId material) const
+{
+	assert(materialTable.isValid(material));
+	return materialTable.isValid(material) ? material : DEFAULT_MATERIAL;
 }
 
-RigidBody* Simulation::addCircle(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, float radius, float density)
+BodyHandle Simulation::addCircle(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, float radius, float density)
 {
-	bodies.push_back(std::make_unique<RigidCircle>(pos, vel, rot, angVel, mass, inertia, material, radius));
-	auto body = bodies.back().get();
+	material = validateMaterial(material);
+
+	RigidBody* body = bodyStorage.addCircle(pos, vel, rot, angVel, mass, inertia, material, radius);
 	if (density > 0.0f)
 	{
 		body->setProperties(body->calculateProperties(density));
 	}
-	return body;
+	return body->handle;
 }
 
-RigidBody* Simulation::addBox(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, const glm::vec2& size, float density)
+BodyHandle Simulation::addBox(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const glm::vec2& size, float density)
 {
+	material = validateMaterial(material);
+
 	float w = size.x * 0.5f;
 	float h = size.y * 0.5f;
 
@@ -343,50 +1317,191 @@ RigidBody* Simulation::addBox(const glm::vec2& pos, const glm::vec2& vel, float
 		{-w, h}, {w, h}, {w, -h}, {-w, -h}
 	};
 
-	bodies.push_back(std::make_unique<RigidPolygon>(pos, vel, rot, angVel, mass, inertia, material, vertices));
-	auto body = bodies.back().get();
+	RigidBody* body = bodyStorage.addPolygon(pos, vel, rot, angVel, mass, inertia, material, vertices);
+	if (density > 0.0f)
+	{
+		body->setProperties(body->calculateProperties(density));
+	}
+	return body->handle;
+}
+
+BodyHandle Simulation::addPolygon(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<glm::vec2>& vertices, float density)
+{
+	material = validateMaterial(material);
+
+	RigidBody* body;
+	if (vertices.size() <= MAX_POLYGON_VERTICES && ConvexDecomposition::isConvex(vertices))
+	{
+		body = bodyStorage.addPolygon(pos, vel, rot, angVel, mass, inertia, material, vertices);
+	}
+	else
+	{
+		// SAT works only with convex shapes and polygon storage is fixed, so such polygon becomes compound body of convex pieces
+		std::vector<CompoundShape> shapes = { CompoundShape::polygon({}, vertices) };
+		body = bodyStorage.addCompound(pos, vel, rot, angVel, mass, inertia, material, shapes);
+	}
 	if (density > 0.0f)
 	{
 		body->setProperties(body->calculateProperties(density));
 	}
-	return body;
+	return body->handle;
 }
 
-RigidBody* Simulation::addPolygon(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, const std::vector<glm::vec2>& vertices, float density)
+BodyHandle Simulation::addCompound(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<CompoundShape>& shapes, float density)
 {
-	bodies.push_back(std::make_unique<RigidPolygon>(pos, vel, rot, angVel, mass, inertia, material, vertices));
-	auto body = bodies.back().get();
+	material = validateMaterial(material);
+
+	RigidBody* body = bodyStorage.addCompound(pos, vel, rot, angVel, mass, inertia, material, shapes);
 	if (density > 0.0f)
 	{
 		body->setProperties(body->calculateProperties(density));
 	}
-	return body;
+	return body->handle;
+}
+
+bool Simulation::removeBody(BodyHandle handle)
+{
+	RigidBody* body = bodyStorage.getBody(handle);
+	if (!body)
+	{
+		return false;
+	}
+
+	constraints.removeConstraintsOf(body);
+
+	// Sleeping bodies, that rested on removed one, would hang in the air. They fell asleep in its island.
+	// Awake body's neighbours are woken by contacts anyway
+	if (body->isSleeping())
+	{
+		wakeUpIsland(body);
+	}
+
+	removedBodies.push_back(body);
+	return bodyStorage.removeBody(handle);
+}
+
+bool Simulation::isValid(BodyHandle handle) const
+{
+	return bodyStorage.isValid(handle);
+}
+
+RigidBody* Simulation::getBody(BodyHandle handle) const
+{
+	return bodyStorage.getBody(handle);
+}
+
+const std::vector<RigidBody*>& Simulation::getBodies() const
+{
+	return bodyStorage.getBodies();
+}
+
+MaterialTable& Simulation::getMaterialTable()
+{
+	return materialTable;
+}
+
+const MaterialTable& Simulation::getMaterialTable() const
+{
+	return materialTable;
+}
+
+ConstraintHandle Simulation::addSpringConstraint(BodyHandle bodyAHandle, BodyHandle bodyBHandle, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float stiffness)
+{
+	RigidBody* bodyA = bodyStorage.getBody(bodyAHandle);
+	RigidBody* bodyB = bodyStorage.getBody(bodyBHandle);
+	if (!bodyA || !bodyB)
+	{
+		return {};
+	}
+	return constraints.addSpring(bodyA, bodyB, anchorA, anchorB, distance, stiffness);
+}
+
+ConstraintHandle Simulation::addSoftSpringConstraint(BodyHandle bodyAHandle, BodyHandle bodyBHandle, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float frequency, float dampingRatio)
+{
+	RigidBody* bodyA = bodyStorage.getBody(bodyAHandle);
+	RigidBody* bodyB = bodyStorage.getBody(bodyBHandle);
+	if (!bodyA || !bodyB)
+	{
+		return {};
+	}
+	return constraints.addSoftSpring(bodyA, bodyB, anchorA, anchorB, distance, frequency, dampingRatio);
+}
+
+ConstraintHandle Simulation::addAxisConstraint(BodyHandle bodyHandle, bool disableX, bool disableY)
+{
+	RigidBody* body = bodyStorage.getBody(bodyHandle);
+	if (!body)
+	{
+		return {};
+	}
+	return constraints.addAxis(body, disableX, disableY);
+}
+
+ConstraintHandle Simulation::addAngularVelocityConstraint(BodyHandle bodyHandle, float angularVelocity)
+{
+	RigidBody* body = bodyStorage.getBody(bodyHandle);
+	if (!body)
+	{
+		return {};
+	}
+	return constraints.addAngularVelocity(body, angularVelocity);
+}
+
+ConstraintHandle Simulation::addRevoluteJoint(BodyHandle bodyAHandle, BodyHandle bodyBHandle, const glm::vec2& anchorA, const glm::vec2& anchorB)
+{
+	RigidBody* bodyA = bodyStorage.getBody(bodyAHandle);
+	RigidBody* bodyB = bodyStorage.getBody(bodyBHandle);
+	if (!bodyA || !bodyB)
+	{
+		return {};
+	}
+	return constraints.addRevoluteJoint(bodyA, bodyB, anchorA, anchorB);
+}
+
+ConstraintHandle Simulation::addDistanceJoint(BodyHandle bodyAHandle, BodyHandle bodyBHandle, const glm::vec2& anchorA, const glm::vec2& anchorB, float length)
+{
+	RigidBody* bodyA = bodyStorage.getBody(bodyAHandle);
+	RigidBody* bodyB = bodyStorage.getBody(bodyBHandle);
+	if (!bodyA || !bodyB)
+	{
+		return {};
+	}
+	return constraints.addDistanceJoint(bodyA, bodyB, anchorA, anchorB, length);
 }
 
-const std::vector<std::unique_ptr<RigidBody>>& Simulation::getBodies() const
+ConstraintHandle Simulation::addPrismaticJoint(BodyHandle bodyAHandle, BodyHandle bodyBHandle, const glm::vec2& anchorA, const glm::vec2& anchorB, const glm::vec2& axis)
 {
-	return bodies;
+	RigidBody* bodyA = bodyStorage.getBody(bodyAHandle);
+	RigidBody* bodyB = bodyStorage.getBody(bodyBHandle);
+	if (!bodyA || !bodyB)
+	{
+		return {};
+	}
+	return constraints.addPrismaticJoint(bodyA, bodyB, anchorA, anchorB, axis);
 }
 
-BaseConstraint* Simulation::addSpringConstraint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float stiffness)
+ConstraintHandle Simulation::addWeldJoint(BodyHandle bodyAHandle, BodyHandle bodyBHandle, const glm::vec2& anchorA, const glm::vec2& anchorB)
 {
-	constraints.push_back(std::make_unique<SpringConstraint>(bodyA, bodyB, anchorA, anchorB, distance, stiffness));
-	return constraints.back().get();
+	RigidBody* bodyA = bodyStorage.getBody(bodyAHandle);
+	RigidBody* bodyB = bodyStorage.getBody(bodyBHandle);
+	if (!bodyA || !bodyB)
+	{
+		return {};
+	}
+	return constraints.addWeldJoint(bodyA, bodyB, anchorA, anchorB);
 }
 
-BaseConstraint* Simulation::addAxisConstraint(RigidBody* body, bool disableX, bool disableY)
+bool Simulation::removeConstraint(ConstraintHandle handle)
 {
-	constraints.push_back(std::make_unique<AxisConstraint>(body, disableX, disableY));
-	return constraints.back().get();
+	return constraints.remove(handle);
 }
 
-BaseConstraint* Simulation::addAngularVelocityConstraint(RigidBody* body, float angularVelocity)
+bool Simulation::isValid(ConstraintHandle handle) const
 {
-	constraints.push_back(std::make_unique<AngularVelocityConstraint>(body, angularVelocity));
-	return constraints.back().get();
+	return constraints.isValid(handle);
 }
 
-const std::vector<std::unique_ptr<BaseConstraint>>& Simulation::getConstraints() const
+const ConstraintStorage& Simulation::getConstraints() const
 {
 	return constraints;
 }
@@ -395,8 +1510,11 @@ int Simulation::update(float deltaTime)
 {
 	Profiler::beginFrame();
 
+	killVolumeEvents.clear();
+
 	accumulatedUpdateTime += deltaTime;
-	unsigned int updatesToPerform = floorf(accumulatedUpdateTime / fixedTimeStep);
+	const float stepTime = getStepTime();
+	unsigned int updatesToPerform = floorf(accumulatedUpdateTime / stepTime);
 	updatesToPerform = std::min(updatesToPerform, maxIterationsPerFrame);
 	if (updatesToPerform <= 0)
 	{
@@ -404,7 +1522,7 @@ int Simulation::update(float deltaTime)
 		return 0;
 	}
 
-	accumulatedUpdateTime -= updatesToPerform * fixedTimeStep;
+	accumulatedUpdateTime -= updatesToPerform * stepTime;
 
 	for (unsigned int i = 0; i < updatesToPerform; i++)
 	{
@@ -415,6 +1533,108 @@ int Simulation::update(float deltaTime)
 	return updatesToPerform;
 }
 
+void Simulation::setCollisionIterations(unsigned int iterations)
+{
+	iterationsToSolveCollisions = iterations;
+}
+
+unsigned int Simulation::getCollisionIterations() const
+{
+	return iterationsToSolveCollisions;
+}
+
+void Simulation::setBlockSolverIterations(unsigned int iterations)
+{
+	blockSolverIterations = iterations;
+}
+
+unsigned int Simulation::getBlockSolverIterations() const
+{
+	return blockSolverIterations;
+}
+
+void Simulation::setSubstepCount(unsigned int count)
+{
+	substepCount = std::max(count, 1u);
+}
+
+unsigned int Simulation::getSubstepCount() const
+{
+	return substepCount;
+}
+
+void Simulation::setWarmStarting(bool enabled)
+{
+	warmStarting = enabled;
+	if (!enabled)
+	{
+		contactCache.clear();
+	}
+}
+
+bool Simulation::isWarmStarting() const
+{
+	return warmStarting;
+}
+
+void Simulation::setSolverType(SolverType type)
+{
+	solverType = type;
+	contactCache.clear();
+
+	// Other solvers detect collisions often enough to work only with touching shapes
+	for (RigidBody* body : bodyStorage.getBodies())
+	{
+		body->setSpeculativeDistance(0.0f);
+	}
+
+	// Only sequential impulse solvers build islands, that are needed for sleeping
+	wakeUpAll();
+}
+
+SolverType Simulation::getSolverType() const
+{
+	return solverType;
+}
+
+void Simulation::setKillVolume(const KillVolume& volume)
+{
+	killVolume = volume;
+}
+
+const KillVolume& Simulation::getKillVolume() const
+{
+	return killVolume;
+}
+
+const std::vector<KillVolumeEvent>& Simulation::getKillVolumeEvents() const
+{
+	return killVolumeEvents;
+}
+
+void Simulation::setSleeping(bool enabled)
+{
+	sleepingEnabled = enabled;
+	if (!enabled)
+	{
+		wakeUpAll();
+	}
+}
+
+bool Simulation::isSleepingEnabled() const
+{
+	return sleepingEnabled;
+}
+
+void Simulation::wakeUpAll()
+{
+	for (RigidBody* body : bodyStorage.getBodies())
+	{
+		body->wakeUp();
+		sleepingIslands.remove(body->sleepingIsland);
+	}
+}
+
 void Simulation::setCollisionDetectionMethod(CollisionDetectionMethod method)
 {
 	collisionMethod = method;
@@ -2,15 +2,21 @@
 #include <vector>
 #include <memory>
 
+#include "Bodies/BodyStorage.h"
+
 #include "Collision/Collisions.h"
+#include "Collision/ContactCache.h"
+
+#include "Solver/ContactSolver.h"
+#include "Solver/IslandBuilder.h"
+#include "Solver/JointSolver.h"
+#include "Solver/SimdContactSolver.h"
+#include "Solver/XpbdSolver.h"
 
 #include "Spatial/Quadtree.h"
 #include "Spatial/SpatialHashGrid.h"
 
-#include "Constraints/BaseConstraint.h"
-#include "Constraints/SpringConstraint.h"
-#include "Constraints/AxisConstraint.h"
-#include "Constraints/AngularVelocityConstraint.h"
+#include "Constraints/ConstraintStorage.h"
 
 enum class CollisionDetectionMethod : int
 {
@@ -20,16 +26,66 @@ enum class CollisionDetectionMethod : int
 	_COUNT
 };
 
+enum class SolverType : int
+{
+	DetectionPerIteration, // Narrowphase runs again before every solver iteration
+	SequentialImpulse, // Narrowphase runs once per step, then velocities and positions are iterated
+	ColoredSequentialImpulse, // Same, but constraints are split by graph coloring instead of islands. Parallel even when whole scene is one island
+	SimdSequentialImpulse, // Same, but velocity iterations solve batches of 4 contacts with SSE
+	SoftStep, // Narrowphase runs once per longer step, then soft contacts are solved in several substeps
+	Xpbd, // Same step and substeps, but contacts, joints, springs and axis locks are compliant position constraints
+	_COUNT
+};
+
+enum class KillVolumePolicy : int
+{
+	None, // Bodies may leave. Outside of world bounds they aren't found by quadtree
+	Remove,
+	Sleep, // Body stays, where it left, until something wakes it
+	Teleport, // Body is stopped and moved to teleport position
+};
+
+// Awake bodies, whose position leaves bounds, are handled by policy at the end of step. Off by default
+struct KillVolume
+{
+	AABB bounds;
+	KillVolumePolicy policy = KillVolumePolicy::None;
+	glm::vec2 teleportPosition = { 0.0f, 0.0f };
+};
+
+// Removed body's handle is already invalid, it only tells host, which handle to forget
+struct KillVolumeEvent
+{
+	BodyHandle body;
+	glm::vec2 position, velocity; // When body left
+	KillVolumePolicy policy;
+};
+
 class Simulation
 {
 	// Simulation parameters
 	float fixedTimeStep = 1.0f / 300.0f;
+	float softStepTimeStep = 1.0f / 60.0f;
+	unsigned int substepCount = 8;
 	unsigned int iterationsToSolveCollisions = 8;
+	unsigned int blockSolverIterations = 6; // Island and colored modes solve two-point manifolds as a block, so stacks settle in fewer iterations
+	unsigned int positionIterations = 3;
 	unsigned int maxIterationsPerFrame = 32;
+	bool warmStarting = true;
+	bool sleepingEnabled = true;
 
 	float gravity = -9.81f;
 
 	const float WORLD_BOUNDS = 3.0f;
+	const float BOUNCE_VELOCITY_THRESHOLD = 0.1f;
+	const float SOFT_STEP_SPECULATIVE_DISTANCE = 0.01f;
+	const size_t MIN_ISLANDS_PER_TASK = 4;
+	const size_t MIN_CONSTRAINTS_PER_TASK = 64;
+
+	// Island falls asleep after all of its bodies stay slower than that for some time
+	const float SLEEP_LINEAR_VELOCITY = 0.01f;
+	const float SLEEP_ANGULAR_VELOCITY = 2.0f * 3.14159265f / 180.0f;
+	const float TIME_TO_SLEEP = 0.5f;
 
 	// Spatial data structures
 	std::unique_ptr<Quadtree> quadtree;
@@ -38,43 +94,154 @@ class Simulation
 	AABB worldBounds;
 
 	CollisionDetectionMethod collisionMethod = CollisionDetectionMethod::SpatialHashGrid;
+	SolverType solverType = SolverType::SequentialImpulse;
+
+	// Impulses of contacts from previous step
+	ContactCache contactCache;
+
+	ContactSolver contactSolver;
+	IslandBuilder islandBuilder;
+	HandleTable<SleepingIsland, SleepingIsland> sleepingIslands;
+	JointSolver jointSolver;
+	SimdContactSolver simdContactSolver;
+	XpbdSolver xpbdSolver;
 
 	//
 	float accumulatedUpdateTime = 0.0;
 
-	std::vector<std::unique_ptr<RigidBody>> bodies;
-	std::vector<std::unique_ptr<BaseConstraint>> constraints;
+	// Bodies live in per-shape pools
+	BodyStorage bodyStorage;
+	ConstraintStorage constraints;
+
+	// Removed since last step, their contacts are forgotten before next one
+	std::vector<const RigidBody*> removedBodies;
+
+	// Bounds are the same as world bounds by default. With a policy set, escaped bodies are handled before they fall out of quadtree
+	KillVolume killVolume;
+
+	// Bodies, that left kill volume during step, by range of body indices. Ranges are checked in parallel
+	std::vector<std::vector<RigidBody*>> escapedBodies;
+
+	// Of all steps of last update
+	std::vector<KillVolumeEvent> killVolumeEvents;
+
+	// Bodies refer to materials by index, contacts look up combined coefficients of a pair
+	MaterialTable materialTable;
+
+	// Scratch buffers for batched transform update
+	std::vector<RigidBody*> dirtyBodies;
+	std::vector<float> dirtyRotations;
+	std::vector<glm::vec2> dirtyCosSin;
 
 	void singlePhysicsStep();
+	void singleDetectionPerIterationStep();
+	void singleSequentialImpulseStep();
+	void singleSoftStep();
+	void singleXpbdStep();
+	void updateSpeculativeDistances(float timeStep);
+	void solveIslandSubsteps(const Island& island, float substepTime);
+	float getStepTime() const;
+	void solveContactsByIslands();
+	void solveContactsByColors();
+	void solveContactsWithSimd();
+	void solveIslandVelocities(const Island& island);
+	void solveIslandPositions(const Island& island);
+	template<typename Func>
+	void forEachColor(Func func);
 	void updateOrientationAndVelocity();
-	void updateConstraints();
+	bool prepareJoints(float timeStep);
+	void solveJointsIteration();
+	void integrateVelocities(float timeStep);
+	void integratePositions(float timeStep, bool withPseudoVelocities);
+	void updateConstraints(float timeStep);
+	bool wakeTouchedBodies();
+	void wakeUpIsland(RigidBody* body);
+	void updateSleeping(float timeStep);
+	void updateTransforms();
+	void findEscapedBodies();
+	void findEscapedBodies(size_t range, size_t first, size_t last);
+	void applyKillVolume();
 
 	void detectCollisions();
 	void detectCollisionsBruteForce();
 	void detectCollisionsWithQuadtree();
 	void detectCollisionsWithHashGrid();
 
+	void warmStartContacts();
 	void resolveCollisionsSingleStep();
+	void resolveCachedCollisionsSingleStep();
+	void applyRestitution();
+	void separateBodies(const CollisionManifold& manifold);
+
+	// Unregistered material would make contacts read outside of pair table, so it's replaced by default one
+	MaterialId validateMaterial(MaterialId material) const;
 public:
 	Simulation();
 
-	// Bodies
-	RigidBody* addCircle(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, float radius, float density = 0.0f);
-	RigidBody* addBox(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, const glm::vec2& size, float density = 0.0f);
-	RigidBody* addPolygon(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, Material* material, const std::vector<glm::vec2>& vertices, float density = 0.0f);
+	// Bodies. Material must be registered in material table, DEFAULT_MATERIAL always is
+	BodyHandle addCircle(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, float radius, float density = 0.0f);
+	BodyHandle addBox(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const glm::vec2& size, float density = 0.0f);
+	BodyHandle addPolygon(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<glm::vec2>& vertices, float density = 0.0f);
+	BodyHandle addCompound(const glm::vec2& pos, const glm::vec2& vel, float rot, float angVel, float mass, float inertia, MaterialId material, const std::vector<CompoundShape>& shapes, float density = 0.0f);
 
-	const std::vector<std::unique_ptr<RigidBody>>& getBodies() const;
+	// Constraints of body are removed with it. Returns false, if body was already removed
+	bool removeBody(BodyHandle handle);
+	bool isValid(BodyHandle handle) const;
 
-	// Constraints
-	BaseConstraint* addSpringConstraint(RigidBody* bodyA, RigidBody* bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float stiffness);
-	BaseConstraint* addAxisConstraint(RigidBody* body, bool disableX, bool disableY);
-	BaseConstraint* addAngularVelocityConstraint(RigidBody* body, float angularVelocity);
+	// Returns nullptr, if body was removed
+	RigidBody* getBody(BodyHandle handle) const;
 
-	const std::vector<std::unique_ptr<BaseConstraint>>& getConstraints() const;
+	const std::vector<RigidBody*>& getBodies() const;
+
+	// Materials
+	MaterialTable& getMaterialTable();
+	const MaterialTable& getMaterialTable() const;
+
+	// Constraints. Adding constraint to removed body returns invalid handle
+	ConstraintHandle addSpringConstraint(BodyHandle bodyA, BodyHandle bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float stiffness);
+	// Implicit spring, stable at any frequency and step. Damping ratio of 1 stops oscillation without overshoot
+	ConstraintHandle addSoftSpringConstraint(BodyHandle bodyA, BodyHandle bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float distance, float frequency, float dampingRatio);
+	ConstraintHandle addAxisConstraint(BodyHandle body, bool disableX, bool disableY);
+	ConstraintHandle addAngularVelocityConstraint(BodyHandle body, float angularVelocity);
+
+	// Joints are solved together with contacts. Anchors are local to body's position, prismatic axis is local to body A
+	ConstraintHandle addRevoluteJoint(BodyHandle bodyA, BodyHandle bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB);
+	ConstraintHandle addDistanceJoint(BodyHandle bodyA, BodyHandle bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, float length);
+	ConstraintHandle addPrismaticJoint(BodyHandle bodyA, BodyHandle bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB, const glm::vec2& axis);
+	ConstraintHandle addWeldJoint(BodyHandle bodyA, BodyHandle bodyB, const glm::vec2& anchorA, const glm::vec2& anchorB);
+
+	// Returns false, if constraint was already removed
+	bool removeConstraint(ConstraintHandle handle);
+	bool isValid(ConstraintHandle handle) const;
+
+	const ConstraintStorage& getConstraints() const;
 
 	// Simulation
 	int update(float deltaTime);
 
+	// Solver
+	void setCollisionIterations(unsigned int iterations);
+	unsigned int getCollisionIterations() const;
+	// Used instead of collision iterations by modes, that solve two-point manifolds as a block
+	void setBlockSolverIterations(unsigned int iterations);
+	unsigned int getBlockSolverIterations() const;
+	void setSubstepCount(unsigned int count);
+	unsigned int getSubstepCount() const;
+	void setWarmStarting(bool enabled);
+	bool isWarmStarting() const;
+	void setSolverType(SolverType type);
+	SolverType getSolverType() const;
+
+	// Kill volume
+	void setKillVolume(const KillVolume& volume);
+	const KillVolume& getKillVolume() const;
+	const std::vector<KillVolumeEvent>& getKillVolumeEvents() const;
+
+	// Sleeping
+	void setSleeping(bool enabled);
+	bool isSleepingEnabled() const;
+	void wakeUpAll();
+
 	// Collision detection method selection
 	void setCollisionDetectionMethod(CollisionDetectionMethod method);
 	CollisionDetectionMethod getCollisionDetectionMethod() const;
@@ -0,0 +1,597 @@
+#include "ContactSolver.h"
+
+#include "Core/Profiler.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+	// Static bodies are shared between islands, so they are never written to
+	inline void applyImpulse(SolverBody& body1, SolverBody& body2, const glm::vec2& r1Perp, const glm::vec2& r2Perp, const glm::vec2& impulse)
+	{
+		if (body1.invMass != 0.0f)
+		{
+			body1.velocity -= impulse * body1.invMass;
+			body1.angularVelocity -= glm::dot(r1Perp, impulse) * body1.invInertia;
+		}
+
+		if (body2.invMass != 0.0f)
+		{
+			body2.velocity += impulse * body2.invMass;
+			body2.angularVelocity += glm::dot(r2Perp, impulse) * body2.invInertia;
+		}
+	}
+
+	inline glm::vec2 getRelativeVelocity(const SolverBody& body1, const SolverBody& body2, const glm::vec2& r1Perp, const glm::vec2& r2Perp)
+	{
+		return (body2.velocity + r2Perp * body2.angularVelocity) - (body1.velocity + r1Perp * body1.angularVelocity);
+	}
+}
+
+ContactSolver::ContactSolver()
+{
+	constraints.reserve(256);
+}
+
+void ContactSolver::prepare(const std::vector<CollisionManifold>& manifolds, const BodyStates& states, float timeStep, bool warmStarting, float restitutionThreshold, const MaterialTable& materials)
+{
+	PROFILE_FUNCTION();
+
+	const size_t countOfBodies = states.size();
+	pseudoVelocities.assign(countOfBodies, glm::vec2(0.0f));
+	pseudoAngularVelocities.assign(countOfBodies, 0.0f);
+
+	gatherBodies(states);
+
+	constraints.resize(manifolds.size());
+	for (size_t m = 0; m < manifolds.size(); m++)
+	{
+		const CollisionManifold& manifold = manifolds[m];
+		ContactConstraint& constraint = constraints[m];
+
+		RigidBody* body1 = manifold.bodyA;
+		RigidBody* body2 = manifold.bodyB;
+
+		constraint.indexA = body1->bodyIndex;
+		constraint.indexB = body2->bodyIndex;
+		constraint.normal = manifold.normal;
+		constraint.tangent = glm::vec2(-manifold.normal.y, manifold.normal.x);
+		const MaterialPair& pair = materials.getPair(body1->material, body2->material);
+		const float elasticity = pair.elasticity;
+		constraint.staticFriction = pair.staticFriction;
+		constraint.dynamicFriction = pair.dynamicFriction;
+		constraint.countOfContacts = manifold.countOfContacts;
+
+		const glm::vec2 centerOfMass1 = body1->getCenterOfMass();
+		const glm::vec2 centerOfMass2 = body2->getCenterOfMass();
+
+		const float invMassSum = body1->getInvMass() + body2->getInvMass();
+
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
+		{
+			ContactPoint& point = constraint.points[i];
+
+			glm::vec2 r1 = manifold.contacts[i] - centerOfMass1;
+			glm::vec2 r2 = manifold.contacts[i] - centerOfMass2;
+
+			point.r1Perp = glm::vec2(-r1.y, r1.x);
+			point.r2Perp = glm::vec2(-r2.y, r2.x);
+
+			float r1PerpDotN = glm::dot(point.r1Perp, constraint.normal);
+			float r2PerpDotN = glm::dot(point.r2Perp, constraint.normal);
+			float normalDenom = invMassSum + r1PerpDotN * r1PerpDotN * body1->getInvInertia() + r2PerpDotN * r2PerpDotN * body2->getInvInertia();
+			point.normalMass = normalDenom > 0.0f ? 1.0f / normalDenom : 0.0f;
+
+			float r1PerpDotT = glm::dot(point.r1Perp, constraint.tangent);
+			float r2PerpDotT = glm::dot(point.r2Perp, constraint.tangent);
+			float tangentDenom = invMassSum + r1PerpDotT * r1PerpDotT * body1->getInvInertia() + r2PerpDotT * r2PerpDotT * body2->getInvInertia();
+			point.tangentMass = tangentDenom > 0.0f ? 1.0f / tangentDenom : 0.0f;
+
+			// Slow contacts don't bounce, so resting bodies don't jitter
+			glm::vec2 relativeVelocity = getRelativeVelocity(solverBodies[constraint.indexA], solverBodies[constraint.indexB], point.r1Perp, point.r2Perp);
+			float approachVelocity = glm::dot(relativeVelocity, constraint.normal);
+			point.restitutionVelocity = approachVelocity < -restitutionThreshold ? -elasticity * approachVelocity : 0.0f;
+
+			float correction = fminf(POSITION_CORRECTION_PERCENT * fmaxf(-manifold.separations[i] - POSITION_SLOP, 0.0f), MAX_POSITION_CORRECTION);
+			point.positionBias = correction / timeStep;
+			point.separation = manifold.separations[i];
+			point.pseudoImpulse = 0.0f;
+
+			point.cached = manifold.cachedContacts[i];
+			if (warmStarting && point.cached != nullptr)
+			{
+				point.normalImpulse = point.cached->previousNormalImpulse;
+				point.tangentImpulse = point.cached->previousTangentImpulse;
+			}
+			else
+			{
+				point.normalImpulse = 0.0f;
+				point.tangentImpulse = 0.0f;
+			}
+		}
+
+		constraint.isBlockSolved = false;
+		if (constraint.countOfContacts == 2)
+		{
+			const ContactPoint& point1 = constraint.points[0];
+			const ContactPoint& point2 = constraint.points[1];
+
+			float rn1A = glm::dot(point1.r1Perp, constraint.normal);
+			float rn1B = glm::dot(point1.r2Perp, constraint.normal);
+			float rn2A = glm::dot(point2.r1Perp, constraint.normal);
+			float rn2B = glm::dot(point2.r2Perp, constraint.normal);
+
+			float k11 = invMassSum + rn1A * rn1A * body1->getInvInertia() + rn1B * rn1B * body2->getInvInertia();
+			float k22 = invMassSum + rn2A * rn2A * body1->getInvInertia() + rn2B * rn2B * body2->getInvInertia();
+			float k12 = invMassSum + rn1A * rn2A * body1->getInvInertia() + rn1B * rn2B * body2->getInvInertia();
+
+			float determinant = k11 * k22 - k12 * k12;
+			if (k11 * k11 < MAX_BLOCK_CONDITION_NUMBER * determinant)
+			{
+				constraint.isBlockSolved = true;
+				constraint.blockMatrix = glm::mat2(k11, k12, k12, k22);
+				constraint.blockMass = glm::inverse(constraint.blockMatrix);
+			}
+		}
+	}
+}
+
+void ContactSolver::gatherBodies(const BodyStates& states)
+{
+	const size_t count = states.size();
+	solverBodies.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		SolverBody& solverBody = solverBodies[i];
+		solverBody.velocity = states.velocities[i];
+		solverBody.angularVelocity = states.angularVelocities[i];
+		solverBody.invMass = states.invMasses[i];
+		solverBody.invInertia = states.invInertias[i];
+		solverBody.deltaPosition = glm::vec2(0.0f);
+		solverBody.deltaRotation = 0.0f;
+	}
+}
+
+void ContactSolver::storeVelocities(BodyStates& states)
+{
+	const size_t count = states.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		if (states.invMasses[i] == 0.0f)
+		{
+			continue;
+		}
+
+		states.velocities[i] = solverBodies[i].velocity;
+		states.angularVelocities[i] = solverBodies[i].angularVelocity;
+	}
+}
+
+void ContactSolver::gatherVelocities(const BodyStates& states, const std::vector<unsigned int>& bodyIndices)
+{
+	for (unsigned int index : bodyIndices)
+	{
+		SolverBody& solverBody = solverBodies[index];
+		solverBody.velocity = states.velocities[index];
+		solverBody.angularVelocity = states.angularVelocities[index];
+	}
+}
+
+void ContactSolver::storeVelocities(BodyStates& states, const std::vector<unsigned int>& bodyIndices)
+{
+	for (unsigned int index : bodyIndices)
+	{
+		if (states.invMasses[index] == 0.0f)
+		{
+			continue;
+		}
+
+		states.velocities[index] = solverBodies[index].velocity;
+		states.angularVelocities[index] = solverBodies[index].angularVelocity;
+	}
+}
+
+void ContactSolver::warmStart(size_t first, size_t last)
+{
+	for (size_t c = first; c < last; c++)
+	{
+		ContactConstraint& constraint = constraints[c];
+
+		for (unsigned int i = 0; i < constraint.countOfContacts; i++)
+		{
+			const ContactPoint& point = constraint.points[i];
+			glm::vec2 impulse = constraint.normal * point.normalImpulse + constraint.tangent * point.tangentImpulse;
+			applyImpulse(solverBodies[constraint.indexA], solverBodies[constraint.indexB], point.r1Perp, point.r2Perp, impulse);
+		}
+	}
+}
+
+void ContactSolver::solveFriction(ContactConstraint& constraint)
+{
+	SolverBody& body1 = solverBodies[constraint.indexA];
+	SolverBody& body2 = solverBodies[constraint.indexB];
+
+	// Friction impulses. Static friction holds while total impulse is inside of its cone, otherwise contact slides
+	for (unsigned int i = 0; i < constraint.countOfContacts; i++)
+	{
+		ContactPoint& point = constraint.points[i];
+
+		glm::vec2 relativeVelocity = getRelativeVelocity(body1, body2, point.r1Perp, point.r2Perp);
+		float jt = -glm::dot(relativeVelocity, constraint.tangent) * point.tangentMass;
+
+		float oldImpulse = point.tangentImpulse;
+		float newImpulse = oldImpulse + jt;
+		if (fabsf(newImpulse) > point.normalImpulse * constraint.staticFriction)
+		{
+			float maxFriction = point.normalImpulse * constraint.dynamicFriction;
+			newImpulse = glm::clamp(newImpulse, -maxFriction, maxFriction);
+		}
+		point.tangentImpulse = newImpulse;
+
+		applyImpulse(body1, body2, point.r1Perp, point.r2Perp, constraint.tangent * (newImpulse - oldImpulse));
+	}
+}
+
+void ContactSolver::solveNormalBlock(ContactConstraint& constraint)
+{
+	SolverBody& body1 = solverBodies[constraint.indexA];
+	SolverBody& body2 = solverBodies[constraint.indexB];
+	ContactPoint& point1 = constraint.points[0];
+	ContactPoint& point2 = constraint.points[1];
+
+	// Mixed LCP: vn = K * x + b, x >= 0, vn >= 0, x * vn = 0. Cases are tried in order, first valid one is applied
+	const glm::vec2 oldImpulse(point1.normalImpulse, point2.normalImpulse);
+
+	float vn1 = glm::dot(getRelativeVelocity(body1, body2, point1.r1Perp, point1.r2Perp), constraint.normal);
+	float vn2 = glm::dot(getRelativeVelocity(body1, body2, point2.r1Perp, point2.r2Perp), constraint.normal);
+	const glm::vec2 b = glm::vec2(vn1, vn2) - constraint.blockMatrix * oldImpulse;
+
+	glm::vec2 newImpulse;
+	for (;;)
+	{
+		// Both contacts push
+		newImpulse = -(constraint.blockMass * b);
+		if (newImpulse.x >= 0.0f && newImpulse.y >= 0.0f)
+		{
+			break;
+		}
+
+		// Only first contact pushes, second one separates
+		newImpulse = glm::vec2(-b.x * point1.normalMass, 0.0f);
+		vn2 = constraint.blockMatrix[0][1] * newImpulse.x + b.y;
+		if (newImpulse.x >= 0.0f && vn2 >= 0.0f)
+		{
+			break;
+		}
+
+		// Only second contact pushes
+		newImpulse = glm::vec2(0.0f, -b.y * point2.normalMass);
+		vn1 = constraint.blockMatrix[1][0] * newImpulse.y + b.x;
+		if (newImpulse.y >= 0.0f && vn1 >= 0.0f)
+		{
+			break;
+		}
+
+		// Both separate
+		newImpulse = glm::vec2(0.0f);
+		if (b.x >= 0.0f && b.y >= 0.0f)
+		{
+			break;
+		}
+
+		// No solution, which can happen only because of rounding. Impulses stay as they were
+		return;
+	}
+
+	const glm::vec2 delta = newImpulse - oldImpulse;
+	applyImpulse(body1, body2, point1.r1Perp, point1.r2Perp, constraint.normal * delta.x);
+	applyImpulse(body1, body2, point2.r1Perp, point2.r2Perp, constraint.normal * delta.y);
+
+	point1.normalImpulse = newImpulse.x;
+	point2.normalImpulse = newImpulse.y;
+}
+
+void ContactSolver::solveVelocities(size_t first, size_t last)
+{
+	for (size_t c = first; c < last; c++)
+	{
+		ContactConstraint& constraint = constraints[c];
+		if (constraint.isBlockSolved)
+		{
+			solveNormalBlock(constraint);
+			solveFriction(constraint);
+			continue;
+		}
+
+		SolverBody& body1 = solverBodies[constraint.indexA];
+		SolverBody& body2 = solverBodies[constraint.indexB];
+
+		// Normal impulses. Total can only push bodies apart
+		for (unsigned int i = 0; i < constraint.countOfContacts; i++)
+		{
+			ContactPoint& point = constraint.points[i];
+
+			glm::vec2 relativeVelocity = getRelativeVelocity(body1, body2, point.r1Perp, point.r2Perp);
+			float jn = -glm::dot(relativeVelocity, constraint.normal) * point.normalMass;
+
+			float oldImpulse = point.normalImpulse;
+			point.normalImpulse = fmaxf(oldImpulse + jn, 0.0f);
+
+			applyImpulse(body1, body2, point.r1Perp, point.r2Perp, constraint.normal * (point.normalImpulse - oldImpulse));
+		}
+
+		solveFriction(constraint);
+	}
+}
+
+void ContactSolver::applyRestitution(size_t first, size_t last)
+{
+	for (size_t c = first; c < last; c++)
+	{
+		ContactConstraint& constraint = constraints[c];
+
+		SolverBody& body1 = solverBodies[constraint.indexA];
+		SolverBody& body2 = solverBodies[constraint.indexB];
+
+		for (unsigned int i = 0; i < constraint.countOfContacts; i++)
+		{
+			ContactPoint& point = constraint.points[i];
+			if (point.restitutionVelocity == 0.0f || point.normalImpulse == 0.0f)
+			{
+				continue;
+			}
+
+			glm::vec2 relativeVelocity = getRelativeVelocity(body1, body2, point.r1Perp, point.r2Perp);
+			float velAlongNormal = glm::dot(relativeVelocity, constraint.normal);
+			float jn = -(velAlongNormal - point.restitutionVelocity) * point.normalMass;
+
+			float oldImpulse = point.normalImpulse;
+			point.normalImpulse = fmaxf(oldImpulse + jn, 0.0f);
+
+			applyImpulse(body1, body2, point.r1Perp, point.r2Perp, constraint.normal * (point.normalImpulse - oldImpulse));
+		}
+	}
+}
+
+void ContactSolver::storeImpulses(size_t first, size_t last)
+{
+	for (size_t c = first; c < last; c++)
+	{
+		const ContactConstraint& constraint = constraints[c];
+
+		for (unsigned int i = 0; i < constraint.countOfContacts; i++)
+		{
+			const ContactPoint& point = constraint.points[i];
+			if (point.cached != nullptr)
+			{
+				point.cached->normalImpulse = point.normalImpulse;
+				point.cached->tangentImpulse = point.tangentImpulse;
+			}
+		}
+	}
+}
+
+void ContactSolver::solvePseudoVelocities(size_t first, size_t last)
+{
+	for (size_t c = first; c < last; c++)
+	{
+		ContactConstraint& constraint = constraints[c];
+
+		const unsigned int index1 = constraint.indexA;
+		const unsigned int index2 = constraint.indexB;
+		const SolverBody& body1 = solverBodies[index1];
+		const SolverBody& body2 = solverBodies[index2];
+
+		for (unsigned int i = 0; i < constraint.countOfContacts; i++)
+		{
+			ContactPoint& point = constraint.points[i];
+			if (point.positionBias == 0.0f && point.pseudoImpulse == 0.0f)
+			{
+				continue;
+			}
+
+			glm::vec2 relativeVelocity = (pseudoVelocities[index2] + point.r2Perp * pseudoAngularVelocities[index2]) - (pseudoVelocities[index1] + point.r1Perp * pseudoAngularVelocities[index1]);
+			float jp = (point.positionBias - glm::dot(relativeVelocity, constraint.normal)) * point.normalMass;
+
+			float oldImpulse = point.pseudoImpulse;
+			point.pseudoImpulse = fmaxf(oldImpulse + jp, 0.0f);
+			glm::vec2 impulse = constraint.normal * (point.pseudoImpulse - oldImpulse);
+
+			if (body1.invMass != 0.0f)
+			{
+				pseudoVelocities[index1] -= impulse * body1.invMass;
+				pseudoAngularVelocities[index1] -= glm::dot(point.r1Perp, impulse) * body1.invInertia;
+			}
+			if (body2.invMass != 0.0f)
+			{
+				pseudoVelocities[index2] += impulse * body2.invMass;
+				pseudoAngularVelocities[index2] += glm::dot(point.r2Perp, impulse) * body2.invInertia;
+			}
+		}
+	}
+}
+
+void ContactSolver::beginSubstepping(float substepTime)
+{
+	// Spring-damper coefficients of soft constraint
+	float hertz = fminf(CONTACT_HERTZ, 0.25f / substepTime);
+	float omega = 2.0f * 3.14159265f * hertz;
+	float a1 = 2.0f * CONTACT_DAMPING_RATIO + substepTime * omega;
+	float a2 = substepTime * omega * a1;
+	float a3 = 1.0f / (1.0f + a2);
+	biasRate = omega / a1;
+	massScale = a2 * a3;
+	impulseScale = a3;
+
+	invSubstepTime = 1.0f / substepTime;
+}
+
+void ContactSolver::finishSubstepping(const std::vector<RigidBody*>& bodies)
+{
+	for (const auto& body : bodies)
+	{
+		if (!body->isAwake())
+		{
+			continue;
+		}
+
+		const SolverBody& solverBody = solverBodies[body->bodyIndex];
+		body->setVelocity(solverBody.velocity);
+		body->setAngularVelocity(solverBody.angularVelocity);
+		body->moveAndRotate(solverBody.deltaPosition, solverBody.deltaRotation);
+	}
+}
+
+void ContactSolver::solveSoft(size_t first, size_t last, bool useBias)
+{
+	for (size_t c = first; c < last; c++)
+	{
+		ContactConstraint& constraint = constraints[c];
+
+		SolverBody& body1 = solverBodies[constraint.indexA];
+		SolverBody& body2 = solverBodies[constraint.indexB];
+
+		for (unsigned int i = 0; i < constraint.countOfContacts; i++)
+		{
+			ContactPoint& point = constraint.points[i];
+
+			// Linear estimate of current separation
+			glm::vec2 pointShift = (body2.deltaPosition + point.r2Perp * body2.deltaRotation) - (body1.deltaPosition + point.r1Perp * body1.deltaRotation);
+			float separation = point.separation + glm::dot(pointShift, constraint.normal);
+
+			float bias = 0.0f, pointMassScale = 1.0f, pointImpulseScale = 0.0f;
+			if (separation > 0.0f)
+			{
+				// Bodies are apart, they may approach only until they touch
+				bias = separation * invSubstepTime;
+			}
+			else if (useBias)
+			{
+				bias = fmaxf(biasRate * separation, -MAX_BIAS_VELOCITY);
+				pointMassScale = massScale;
+				pointImpulseScale = impulseScale;
+			}
+
+			glm::vec2 relativeVelocity = getRelativeVelocity(body1, body2, point.r1Perp, point.r2Perp);
+			float vn = glm::dot(relativeVelocity, constraint.normal);
+			float jn = -point.normalMass * pointMassScale * (vn + bias) - pointImpulseScale * point.normalImpulse;
+
+			float oldImpulse = point.normalImpulse;
+			point.normalImpulse = fmaxf(oldImpulse + jn, 0.0f);
+
+			applyImpulse(body1, body2, point.r1Perp, point.r2Perp, constraint.normal * (point.normalImpulse - oldImpulse));
+		}
+
+		solveFriction(constraint);
+	}
+}
+
+const std::vector<glm::vec2>& ContactSolver::getPseudoVelocities() const
+{
+	return pseudoVelocities;
+}
+
+const std::vector<float>& ContactSolver::getPseudoAngularVelocities() const
+{
+	return pseudoAngularVelocities;
+}
+
+void ContactSolver::colorConstraints(size_t countOfBodies)
+{
+	PROFILE_FUNCTION();
+
+	bodyColors.assign(countOfBodies, 0);
+	constraintColors.resize(constraints.size());
+
+	// Greedy coloring. Static bodies aren't written by solver, so they don't take colors
+	std::vector<size_t> colorSizes(MAX_COLORS + 1, 0);
+	unsigned int countOfColors = 0;
+	for (size_t c = 0; c < constraints.size(); c++)
+	{
+		const ContactConstraint& constraint = constraints[c];
+		const bool isAStatic = solverBodies[constraint.indexA].invMass == 0.0f;
+		const bool isBStatic = solverBodies[constraint.indexB].invMass == 0.0f;
+
+		uint64_t usedColors = 0;
+		if (!isAStatic)
+		{
+			usedColors |= bodyColors[constraint.indexA];
+		}
+		if (!isBStatic)
+		{
+			usedColors |= bodyColors[constraint.indexB];
+		}
+
+		unsigned int color = MAX_COLORS;
+		for (unsigned int i = 0; i < MAX_COLORS; i++)
+		{
+			if ((usedColors & (uint64_t(1) << i)) == 0)
+			{
+				color = i;
+				break;
+			}
+		}
+
+		if (color != MAX_COLORS)
+		{
+			uint64_t bit = uint64_t(1) << color;
+			if (!isAStatic)
+			{
+				bodyColors[constraint.indexA] |= bit;
+			}
+			if (!isBStatic)
+			{
+				bodyColors[constraint.indexB] |= bit;
+			}
+			countOfColors = std::max(countOfColors, color + 1);
+		}
+
+		constraintColors[c] = color;
+		colorSizes[color]++;
+	}
+
+	// Counting sort by color. Overflow color goes last
+	colorOffsets.resize(countOfColors + 1);
+	size_t offset = 0;
+	for (unsigned int color = 0; color < countOfColors; color++)
+	{
+		colorOffsets[color] = offset;
+		offset += colorSizes[color];
+	}
+	colorOffsets[countOfColors] = offset;
+
+	std::vector<size_t> cursors(colorOffsets.begin(), colorOffsets.end());
+	sortedConstraints.resize(constraints.size());
+	for (size_t c = 0; c < constraints.size(); c++)
+	{
+		unsigned int color = std::min(constraintColors[c], countOfColors);
+		sortedConstraints[cursors[color]++] = constraints[c];
+	}
+	constraints.swap(sortedConstraints);
+}
+
+const std::vector<size_t>& ContactSolver::getColorOffsets() const
+{
+	return colorOffsets;
+}
+
+std::vector<SolverBody>& ContactSolver::getSolverBodies()
+{
+	return solverBodies;
+}
+
+const std::vector<SolverBody>& ContactSolver::getSolverBodies() const
+{
+	return solverBodies;
+}
+
+std::vector<ContactConstraint>& ContactSolver::getConstraints()
+{
+	return constraints;
+}
+
+const std::vector<ContactConstraint>& ContactSolver::getConstraints() const
+{
+	return constraints;
+}
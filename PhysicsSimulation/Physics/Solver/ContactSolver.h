@@ -0,0 +1,139 @@
+#pragma once
+#include "Physics/Collision/Collisions.h"
+#include "Physics/Collision/ContactCache.h"
+
+#include <vector>
+#include <cstdint>
+
+// Values of a single contact point, that don't change during velocity iterations
+struct ContactPoint
+{
+	glm::vec2 r1Perp, r2Perp; // Perpendiculars of arms from centers of mass to contact
+	float normalMass, tangentMass;
+
+	float normalImpulse = 0.0f, tangentImpulse = 0.0f;
+
+	float restitutionVelocity; // Normal velocity, that restitution aims for. Zero, when contact doesn't bounce
+	float separation; // Negative, when bodies overlap. Measured at detection
+
+	// Split impulse. Pseudo velocity, that removes part of penetration during this step, and impulse that reaches it
+	float positionBias;
+	float pseudoImpulse = 0.0f;
+
+	CachedContact* cached;
+};
+
+// Copy of body's state, that iterations work on, so they don't touch RigidBody objects and their materials
+struct SolverBody
+{
+	glm::vec2 velocity;
+	float angularVelocity;
+	float invMass, invInertia;
+
+	// Movement since collisions were detected. Only substepping uses it
+	glm::vec2 deltaPosition;
+	float deltaRotation;
+};
+
+struct ContactConstraint
+{
+	// Indices of bodies in solver body array
+	unsigned int indexA, indexB;
+
+	glm::vec2 normal, tangent;
+	float staticFriction, dynamicFriction;
+
+	ContactPoint points[2];
+	unsigned int countOfContacts;
+
+	// Two contacts are solved together as 2x2 block, unless their rows are nearly dependent
+	bool isBlockSolved;
+	glm::mat2 blockMatrix, blockMass;
+};
+
+// Sequential impulse solver. Contacts are detected once per step, then velocities are iterated with accumulated impulses
+class ContactSolver
+{
+	const float POSITION_CORRECTION_PERCENT = 0.2f;
+	const float POSITION_SLOP = 0.05f * 0.01f;
+	const float MAX_POSITION_CORRECTION = 0.01f;
+
+	// Limit of condition number of block matrix. Worse conditioned pairs are solved point by point
+	const float MAX_BLOCK_CONDITION_NUMBER = 1000.0f;
+
+	// Colors are stored as bits of a mask per body
+	const unsigned int MAX_COLORS = 64;
+
+	std::vector<ContactConstraint> constraints;
+	std::vector<SolverBody> solverBodies;
+
+	// Soft contacts. Stiffness is set in hertz, so it doesn't depend on mass and step. It's limited by quarter of substep rate, bodies are small, so it's as stiff as substeps allow
+	const float CONTACT_HERTZ = 120.0f;
+	const float CONTACT_DAMPING_RATIO = 10.0f;
+	const float MAX_BIAS_VELOCITY = 1.0f;
+
+	float biasRate = 0.0f, massScale = 1.0f, impulseScale = 0.0f;
+	float invSubstepTime = 0.0f;
+
+	// Pseudo velocities per body index. They move bodies out of penetration, but aren't kept after step, so separation doesn't add energy
+	std::vector<glm::vec2> pseudoVelocities;
+	std::vector<float> pseudoAngularVelocities;
+
+	// Graph coloring
+	std::vector<uint64_t> bodyColors;
+	std::vector<unsigned int> constraintColors;
+	std::vector<size_t> colorOffsets;
+	std::vector<ContactConstraint> sortedConstraints;
+	void solveFriction(ContactConstraint& constraint);
+	void solveNormalBlock(ContactConstraint& constraint);
+public:
+	ContactSolver();
+
+	// Copies bodies' state and builds constraints from manifolds. Masses, materials and restitution are computed here once per step.
+	// Impulses of cached contacts are used as starting ones
+	void prepare(const std::vector<CollisionManifold>& manifolds, const BodyStates& states, float timeStep, bool warmStarting, float restitutionThreshold, const MaterialTable& materials);
+
+	// Copies bodies' state arrays into solver bodies. Called by prepare, separately it's used, when only joints are solved
+	void gatherBodies(const BodyStates& states);
+
+	// Writes solved velocities back into state arrays of dynamic bodies
+	void storeVelocities(BodyStates& states);
+
+	// Same, but only velocities of listed bodies are copied. Used, when joints are iterated together with contacts, that are solved on bodies
+	void gatherVelocities(const BodyStates& states, const std::vector<unsigned int>& bodyIndices);
+	void storeVelocities(BodyStates& states, const std::vector<unsigned int>& bodyIndices);
+
+	// Following methods work on constraints in range [first, last). Ranges that don't share dynamic bodies can be solved in parallel
+	void warmStart(size_t first, size_t last);
+	void solveVelocities(size_t first, size_t last);
+	void applyRestitution(size_t first, size_t last);
+
+	// Saves impulses into contact cache for warm starting next step
+	void storeImpulses(size_t first, size_t last);
+
+	// Single iteration of position correction. Solves pseudo velocities, that are added to real ones only when positions are integrated
+	void solvePseudoVelocities(size_t first, size_t last);
+	const std::vector<glm::vec2>& getPseudoVelocities() const;
+	const std::vector<float>& getPseudoAngularVelocities() const;
+
+	// Substepping with soft contacts. Computes softness for given substep. Substeps move solver bodies only,
+	// separation is estimated from their movement without running narrowphase again
+	void beginSubstepping(float substepTime);
+
+	// Writes velocities back and moves bodies by distance, they passed during substeps
+	void finishSubstepping(const std::vector<RigidBody*>& bodies);
+
+	// Single substep iteration. With bias penetration is pushed out softly, without it (relax) contacts are solved as rigid to remove bias velocity
+	void solveSoft(size_t first, size_t last, bool useBias);
+
+	// Reorders constraints so that no two constraints of the same color share a dynamic body. Constraints of one color can be solved in parallel.
+	// Constraints that didn't fit into any color are stored after the last color and must be solved serially
+	void colorConstraints(size_t countOfBodies);
+	const std::vector<size_t>& getColorOffsets() const;
+
+	std::vector<SolverBody>& getSolverBodies();
+	const std::vector<SolverBody>& getSolverBodies() const;
+
+	std::vector<ContactConstraint>& getConstraints();
+	const std::vector<ContactConstraint>& getConstraints() const;
+};
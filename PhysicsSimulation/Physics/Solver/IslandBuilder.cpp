@@ -0,0 +1,193 @@
+#include "IslandBuilder.h"
+
+#include "Core/Profiler.h"
+
+unsigned int IslandBuilder::find(unsigned int index)
+{
+	// Path halving
+	while (parents[index] != index)
+	{
+		parents[index] = parents[parents[index]];
+		index = parents[index];
+	}
+	return index;
+}
+
+void IslandBuilder::unite(unsigned int indexA, unsigned int indexB)
+{
+	unsigned int rootA = find(indexA);
+	unsigned int rootB = find(indexB);
+	if (rootA == rootB)
+	{
+		return;
+	}
+
+	// Smaller index becomes root, so islands are numbered in order of bodies
+	if (rootA < rootB)
+	{
+		parents[rootB] = rootA;
+	}
+	else
+	{
+		parents[rootA] = rootB;
+	}
+}
+
+void IslandBuilder::buildBodyIslands(const std::vector<RigidBody*>& bodies, const std::vector<CollisionManifold>& manifolds, const ConstraintStorage& constraints)
+{
+	PROFILE_FUNCTION();
+
+	const unsigned int countOfBodies = (unsigned int)bodies.size();
+
+	parents.resize(countOfBodies);
+	for (unsigned int i = 0; i < countOfBodies; i++)
+	{
+		parents[i] = i;
+	}
+
+	// Union bodies
+	for (const auto& manifold : manifolds)
+	{
+		if (manifold.bodyA->isAwake() && manifold.bodyB->isAwake())
+		{
+			unite(manifold.bodyA->bodyIndex, manifold.bodyB->bodyIndex);
+		}
+	}
+
+	constraints.forEachJoint([this](ConstraintId, const RigidBody* bodyA, const RigidBody* bodyB)
+		{
+			if (bodyA->isAwake() && bodyB->isAwake())
+			{
+				unite(bodyA->bodyIndex, bodyB->bodyIndex);
+			}
+		});
+
+	const SpringConstraints& springs = constraints.getSprings();
+	for (size_t i = 0; i < springs.size(); i++)
+	{
+		RigidBody* bodyA = springs.bodiesA[i];
+		RigidBody* bodyB = springs.bodiesB[i];
+		if (bodyA->isAwake() && bodyB->isAwake())
+		{
+			unite(bodyA->bodyIndex, bodyB->bodyIndex);
+		}
+	}
+
+	// Number islands
+	islands.clear();
+	rootToIsland.assign(countOfBodies, NO_ISLAND);
+	for (unsigned int i = 0; i < countOfBodies; i++)
+	{
+		RigidBody* body = bodies[i];
+		if (!body->isAwake())
+		{
+			body->islandIndex = NO_ISLAND;
+			continue;
+		}
+
+		unsigned int root = find(i);
+		if (rootToIsland[root] == NO_ISLAND)
+		{
+			rootToIsland[root] = (unsigned int)islands.size();
+			islands.push_back({ 0, 0, 0, 0, 0, 0 });
+		}
+
+		body->islandIndex = rootToIsland[root];
+		islands[body->islandIndex].countOfBodies++;
+	}
+
+	// Counting sort of bodies by island
+	size_t bodyOffset = 0;
+	for (auto& island : islands)
+	{
+		island.firstBody = bodyOffset;
+		bodyOffset += island.countOfBodies;
+
+		// Used as write cursor below
+		island.countOfBodies = 0;
+	}
+
+	islandBodies.resize(bodyOffset);
+	for (const auto& body : bodies)
+	{
+		if (body->islandIndex == NO_ISLAND)
+		{
+			continue;
+		}
+
+		Island& island = islands[body->islandIndex];
+		islandBodies[island.firstBody + island.countOfBodies++] = body;
+	}
+}
+
+void IslandBuilder::build(const std::vector<RigidBody*>& bodies, std::vector<CollisionManifold>& manifolds, const ConstraintStorage& constraints)
+{
+	PROFILE_FUNCTION();
+
+	buildBodyIslands(bodies, manifolds, constraints);
+
+	// Counting sort of manifolds by island
+	for (const auto& manifold : manifolds)
+	{
+		RigidBody* body = manifold.bodyA->isAwake() ? manifold.bodyA : manifold.bodyB;
+		islands[body->islandIndex].countOfManifolds++;
+	}
+
+	// Joint belongs to island of its awake body. Joints between resting bodies aren't solved
+	constraints.forEachJoint([this](ConstraintId, const RigidBody* bodyA, const RigidBody* bodyB)
+		{
+			unsigned int island = bodyA->isAwake() ? bodyA->islandIndex : bodyB->islandIndex;
+			if (island != NO_ISLAND)
+			{
+				islands[island].countOfJoints++;
+			}
+		});
+
+	size_t manifoldOffset = 0, jointOffset = 0;
+	for (auto& island : islands)
+	{
+		island.firstManifold = manifoldOffset;
+		island.firstJoint = jointOffset;
+		manifoldOffset += island.countOfManifolds;
+		jointOffset += island.countOfJoints;
+
+		// Used as write cursors below
+		island.countOfManifolds = 0;
+		island.countOfJoints = 0;
+	}
+
+	sortedManifolds.resize(manifolds.size());
+	for (const auto& manifold : manifolds)
+	{
+		RigidBody* body = manifold.bodyA->isAwake() ? manifold.bodyA : manifold.bodyB;
+		Island& island = islands[body->islandIndex];
+		sortedManifolds[island.firstManifold + island.countOfManifolds++] = manifold;
+	}
+	manifolds.swap(sortedManifolds);
+
+	islandJoints.resize(jointOffset);
+	constraints.forEachJoint([this](ConstraintId id, const RigidBody* bodyA, const RigidBody* bodyB)
+		{
+			unsigned int islandIndex = bodyA->isAwake() ? bodyA->islandIndex : bodyB->islandIndex;
+			if (islandIndex != NO_ISLAND)
+			{
+				Island& island = islands[islandIndex];
+				islandJoints[island.firstJoint + island.countOfJoints++] = id;
+			}
+		});
+}
+
+const std::vector<Island>& IslandBuilder::getIslands() const
+{
+	return islands;
+}
+
+const std::vector<RigidBody*>& IslandBuilder::getIslandBodies() const
+{
+	return islandBodies;
+}
+
+const std::vector<ConstraintId>& IslandBuilder::getIslandJoints() const
+{
+	return islandJoints;
+}
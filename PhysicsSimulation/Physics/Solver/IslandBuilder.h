@@ -0,0 +1,49 @@
+#pragma once
+#include "Physics/Collision/Collisions.h"
+#include "Physics/Constraints/ConstraintStorage.h"
+
+#include <vector>
+
+// Island index of static and sleeping bodies
+constexpr unsigned int NO_ISLAND = 0xFFFFFFFF;
+
+// Group of awake bodies, that touch each other directly or through other bodies. Static bodies don't connect islands
+struct Island
+{
+	size_t firstManifold, countOfManifolds;
+	size_t firstBody, countOfBodies;
+	size_t firstJoint, countOfJoints;
+};
+
+// Bodies of island, that fell asleep as a whole. They may rest on each other, so removing one of them wakes the rest
+struct SleepingIsland
+{
+	std::vector<BodyHandle> bodies;
+};
+
+// Splits bodies into islands with union-find over contacts and constraints
+class IslandBuilder
+{
+	std::vector<unsigned int> parents;
+	std::vector<unsigned int> rootToIsland;
+
+	std::vector<Island> islands;
+	std::vector<RigidBody*> islandBodies;
+	std::vector<CollisionManifold> sortedManifolds;
+	std::vector<ConstraintId> islandJoints;
+
+	unsigned int find(unsigned int index);
+	void unite(unsigned int indexA, unsigned int indexB);
+public:
+	// Sets island index of every body and lists bodies of each island. Manifolds and joints aren't sorted, so their ranges of islands are empty.
+	// Enough for modes, that don't solve by islands, but put islands to sleep
+	void buildBodyIslands(const std::vector<RigidBody*>& bodies, const std::vector<CollisionManifold>& manifolds, const ConstraintStorage& constraints);
+
+	// Same, and also reorders manifolds, so manifolds of each island are stored contiguously.
+	// Every manifold must have at least one awake body. Joints of each island are listed contiguously too
+	void build(const std::vector<RigidBody*>& bodies, std::vector<CollisionManifold>& manifolds, const ConstraintStorage& constraints);
+
+	const std::vector<Island>& getIslands() const;
+	const std::vector<RigidBody*>& getIslandBodies() const;
+	const std::vector<ConstraintId>& getIslandJoints() const;
+};
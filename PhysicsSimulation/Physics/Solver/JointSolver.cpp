@@ -0,0 +1,455 @@
+#include "JointSolver.h"
+
+#include "Core/CoreMath.h"
+#include "Core/Profiler.h"
+
+#include <cfloat>
+#include <math.h>
+
+namespace
+{
+	inline glm::vec2 perpendicular(const glm::vec2& v)
+	{
+		return glm::vec2(-v.y, v.x);
+	}
+
+	inline glm::vec2 getPointVelocity(const SolverBody& body, const glm::vec2& r)
+	{
+		return body.velocity + perpendicular(r) * body.angularVelocity;
+	}
+
+	// Static bodies are shared between islands, so they are never written to
+	inline void applyImpulse(SolverBody& bodyA, SolverBody& bodyB, const glm::vec2& impulse, float angularImpulseA, float angularImpulseB)
+	{
+		if (bodyA.invMass != 0.0f)
+		{
+			bodyA.velocity -= impulse * bodyA.invMass;
+			bodyA.angularVelocity -= angularImpulseA * bodyA.invInertia;
+		}
+
+		if (bodyB.invMass != 0.0f)
+		{
+			bodyB.velocity += impulse * bodyB.invMass;
+			bodyB.angularVelocity += angularImpulseB * bodyB.invInertia;
+		}
+	}
+
+	inline void applyLinearImpulse(SolverBody& bodyA, SolverBody& bodyB, const glm::vec2& rA, const glm::vec2& rB, const glm::vec2& impulse)
+	{
+		applyImpulse(bodyA, bodyB, impulse, CoreMath::cross(rA, impulse), CoreMath::cross(rB, impulse));
+	}
+
+	inline glm::vec2 getWorldAnchor(const RigidBody* body, const glm::vec2& localAnchor)
+	{
+		return body->getPosition() + CoreMath::rotatePoint(localAnchor, body->getRotation());
+	}
+
+	// Inverse of symmetric 2x2 matrix. Singular one gives zero mass, so joint does nothing
+	inline glm::mat2 invertSymmetric(float k11, float k12, float k22)
+	{
+		float determinant = k11 * k22 - k12 * k12;
+		if (determinant == 0.0f)
+		{
+			return glm::mat2(0.0f);
+		}
+
+		float invDeterminant = 1.0f / determinant;
+		return glm::mat2(k22 * invDeterminant, -k12 * invDeterminant, -k12 * invDeterminant, k11 * invDeterminant);
+	}
+
+	void prepareRevolute(RevoluteJoint& joint, const std::vector<SolverBody>& bodies, float biasRate, bool warmStarting)
+	{
+		joint.indexA = joint.bodyA->bodyIndex;
+		joint.indexB = joint.bodyB->bodyIndex;
+		const SolverBody& bodyA = bodies[joint.indexA];
+		const SolverBody& bodyB = bodies[joint.indexB];
+
+		glm::vec2 pA = getWorldAnchor(joint.bodyA, joint.localAnchorA);
+		glm::vec2 pB = getWorldAnchor(joint.bodyB, joint.localAnchorB);
+		joint.rA = pA - joint.bodyA->getCenterOfMass();
+		joint.rB = pB - joint.bodyB->getCenterOfMass();
+
+		const glm::vec2& rA = joint.rA;
+		const glm::vec2& rB = joint.rB;
+		const float invMassSum = bodyA.invMass + bodyB.invMass;
+		float k11 = invMassSum + bodyA.invInertia * rA.y * rA.y + bodyB.invInertia * rB.y * rB.y;
+		float k12 = -bodyA.invInertia * rA.x * rA.y - bodyB.invInertia * rB.x * rB.y;
+		float k22 = invMassSum + bodyA.invInertia * rA.x * rA.x + bodyB.invInertia * rB.x * rB.x;
+		joint.mass = invertSymmetric(k11, k12, k22);
+
+		joint.bias = (pB - pA) * biasRate;
+
+		if (!warmStarting)
+		{
+			joint.impulse = glm::vec2(0.0f);
+		}
+	}
+
+	void prepareDistance(DistanceJoint& joint, const std::vector<SolverBody>& bodies, float biasRate, bool warmStarting)
+	{
+		joint.indexA = joint.bodyA->bodyIndex;
+		joint.indexB = joint.bodyB->bodyIndex;
+		const SolverBody& bodyA = bodies[joint.indexA];
+		const SolverBody& bodyB = bodies[joint.indexB];
+
+		glm::vec2 pA = getWorldAnchor(joint.bodyA, joint.localAnchorA);
+		glm::vec2 pB = getWorldAnchor(joint.bodyB, joint.localAnchorB);
+		joint.rA = pA - joint.bodyA->getCenterOfMass();
+		joint.rB = pB - joint.bodyB->getCenterOfMass();
+
+		// Coincident anchors have no direction, any axis works
+		glm::vec2 dpos = pB - pA;
+		float distance = glm::length(dpos);
+		joint.axis = distance > 0.0f ? dpos / distance : glm::vec2(1.0f, 0.0f);
+
+		float crA = CoreMath::cross(joint.rA, joint.axis);
+		float crB = CoreMath::cross(joint.rB, joint.axis);
+		float k = bodyA.invMass + bodyB.invMass + bodyA.invInertia * crA * crA + bodyB.invInertia * crB * crB;
+		joint.mass = k > 0.0f ? 1.0f / k : 0.0f;
+
+		joint.bias = (distance - joint.length) * biasRate;
+
+		if (!warmStarting)
+		{
+			joint.impulse = 0.0f;
+		}
+	}
+
+	void preparePrismatic(PrismaticJoint& joint, const std::vector<SolverBody>& bodies, float biasRate, bool warmStarting)
+	{
+		joint.indexA = joint.bodyA->bodyIndex;
+		joint.indexB = joint.bodyB->bodyIndex;
+		const SolverBody& bodyA = bodies[joint.indexA];
+		const SolverBody& bodyB = bodies[joint.indexB];
+
+		glm::vec2 pA = getWorldAnchor(joint.bodyA, joint.localAnchorA);
+		glm::vec2 pB = getWorldAnchor(joint.bodyB, joint.localAnchorB);
+		glm::vec2 rA = pA - joint.bodyA->getCenterOfMass();
+		glm::vec2 rB = pB - joint.bodyB->getCenterOfMass();
+		glm::vec2 dpos = pB - pA;
+
+		glm::vec2 axis = CoreMath::rotatePoint(joint.localAxisA, joint.bodyA->getRotation());
+		joint.perpendicular = perpendicular(axis);
+		joint.s1 = CoreMath::cross(dpos + rA, joint.perpendicular);
+		joint.s2 = CoreMath::cross(rB, joint.perpendicular);
+
+		float k11 = bodyA.invMass + bodyB.invMass + bodyA.invInertia * joint.s1 * joint.s1 + bodyB.invInertia * joint.s2 * joint.s2;
+		float k12 = bodyA.invInertia * joint.s1 + bodyB.invInertia * joint.s2;
+		float k22 = bodyA.invInertia + bodyB.invInertia;
+		if (k22 == 0.0f)
+		{
+			// Neither body can rotate, angular row is left without effect
+			k22 = 1.0f;
+		}
+		joint.mass = invertSymmetric(k11, k12, k22);
+
+		float angle = joint.bodyB->getRotation() - joint.bodyA->getRotation() - joint.referenceAngle;
+		joint.bias = glm::vec2(glm::dot(joint.perpendicular, dpos), angle) * biasRate;
+
+		if (!warmStarting)
+		{
+			joint.impulse = glm::vec2(0.0f);
+		}
+	}
+
+	void prepareSoftSpring(SoftSpringJoint& joint, const std::vector<SolverBody>& bodies, float solveTime, float maxFrequency, bool warmStarting)
+	{
+		joint.indexA = joint.bodyA->bodyIndex;
+		joint.indexB = joint.bodyB->bodyIndex;
+		const SolverBody& bodyA = bodies[joint.indexA];
+		const SolverBody& bodyB = bodies[joint.indexB];
+
+		glm::vec2 pA = getWorldAnchor(joint.bodyA, joint.localAnchorA);
+		glm::vec2 pB = getWorldAnchor(joint.bodyB, joint.localAnchorB);
+		joint.rA = pA - joint.bodyA->getCenterOfMass();
+		joint.rB = pB - joint.bodyB->getCenterOfMass();
+
+		glm::vec2 dpos = pB - pA;
+		float distance = glm::length(dpos);
+		joint.axis = distance > 0.0f ? dpos / distance : glm::vec2(1.0f, 0.0f);
+		joint.stretch = distance - joint.distance;
+
+		float crA = CoreMath::cross(joint.rA, joint.axis);
+		float crB = CoreMath::cross(joint.rB, joint.axis);
+		float k = bodyA.invMass + bodyB.invMass + bodyA.invInertia * crA * crA + bodyB.invInertia * crB * crB;
+		joint.mass = k > 0.0f ? 1.0f / k : 0.0f;
+
+		// Spring-damper coefficients of soft constraint, same as of soft contacts
+		float omega = 2.0f * 3.14159265f * fminf(joint.frequency, maxFrequency);
+		float a1 = 2.0f * joint.dampingRatio + solveTime * omega;
+		if (a1 > 0.0f)
+		{
+			float a2 = solveTime * omega * a1;
+			float a3 = 1.0f / (1.0f + a2);
+			joint.biasRate = omega / a1;
+			joint.massScale = a2 * a3;
+			joint.impulseScale = a3;
+		}
+		else
+		{
+			// Neither stiffness nor damping, spring does nothing
+			joint.biasRate = 0.0f;
+			joint.massScale = 0.0f;
+			joint.impulseScale = 1.0f;
+		}
+
+		if (!warmStarting)
+		{
+			joint.impulse = 0.0f;
+		}
+	}
+
+	void prepareWeld(WeldJoint& joint, const std::vector<SolverBody>& bodies, float biasRate, bool warmStarting)
+	{
+		joint.indexA = joint.bodyA->bodyIndex;
+		joint.indexB = joint.bodyB->bodyIndex;
+		const SolverBody& bodyA = bodies[joint.indexA];
+		const SolverBody& bodyB = bodies[joint.indexB];
+
+		glm::vec2 pA = getWorldAnchor(joint.bodyA, joint.localAnchorA);
+		glm::vec2 pB = getWorldAnchor(joint.bodyB, joint.localAnchorB);
+		joint.rA = pA - joint.bodyA->getCenterOfMass();
+		joint.rB = pB - joint.bodyB->getCenterOfMass();
+
+		const glm::vec2& rA = joint.rA;
+		const glm::vec2& rB = joint.rB;
+		const float mA = bodyA.invMass, mB = bodyB.invMass;
+		const float iA = bodyA.invInertia, iB = bodyB.invInertia;
+
+		float k11 = mA + mB + rA.y * rA.y * iA + rB.y * rB.y * iB;
+		float k12 = -rA.y * rA.x * iA - rB.y * rB.x * iB;
+		float k13 = -rA.y * iA - rB.y * iB;
+		float k22 = mA + mB + rA.x * rA.x * iA + rB.x * rB.x * iB;
+		float k23 = rA.x * iA + rB.x * iB;
+		float k33 = iA + iB;
+
+		glm::mat3 k(k11, k12, k13, k12, k22, k23, k13, k23, k33);
+		if (k33 == 0.0f || glm::determinant(k) == 0.0f)
+		{
+			// Rotation can't be corrected, only point constraint is solved
+			glm::mat2 pointMass = invertSymmetric(k11, k12, k22);
+			joint.mass = glm::mat3(0.0f);
+			joint.mass[0][0] = pointMass[0][0];
+			joint.mass[0][1] = pointMass[0][1];
+			joint.mass[1][0] = pointMass[1][0];
+			joint.mass[1][1] = pointMass[1][1];
+		}
+		else
+		{
+			joint.mass = glm::inverse(k);
+		}
+
+		float angle = joint.bodyB->getRotation() - joint.bodyA->getRotation() - joint.referenceAngle;
+		joint.bias = glm::vec3(pB - pA, angle) * biasRate;
+
+		if (!warmStarting)
+		{
+			joint.impulse = glm::vec3(0.0f);
+		}
+	}
+}
+
+void JointSolver::prepare(ConstraintStorage& constraints, std::vector<SolverBody>& solverBodies, float stepTime, float solveTime, bool warmStarting)
+{
+	PROFILE_FUNCTION();
+
+	this->constraints = &constraints;
+	this->solverBodies = &solverBodies;
+
+	// Joint between resting bodies would accumulate velocity, that is never integrated
+	activeJoints.clear();
+	activeBodies.clear();
+	constraints.forEachJoint([this](ConstraintId id, const RigidBody* bodyA, const RigidBody* bodyB)
+		{
+			if (bodyA->isAwake() || bodyB->isAwake())
+			{
+				activeJoints.push_back(id);
+				activeBodies.push_back(bodyA->bodyIndex);
+				activeBodies.push_back(bodyB->bodyIndex);
+			}
+		});
+
+	const float biasRate = POSITION_CORRECTION_PERCENT / stepTime;
+	const float maxSpringFrequency = solveTime < stepTime ? MAX_SUBSTEP_SPRING_FREQUENCY_RATIO / solveTime : FLT_MAX;
+	for (const ConstraintId& id : activeJoints)
+	{
+		switch (id.type)
+		{
+		case ConstraintType::RevoluteJoint:
+			prepareRevolute(constraints.getRevoluteJoints()[id.index], solverBodies, biasRate, warmStarting);
+			break;
+		case ConstraintType::DistanceJoint:
+			prepareDistance(constraints.getDistanceJoints()[id.index], solverBodies, biasRate, warmStarting);
+			break;
+		case ConstraintType::PrismaticJoint:
+			preparePrismatic(constraints.getPrismaticJoints()[id.index], solverBodies, biasRate, warmStarting);
+			break;
+		case ConstraintType::WeldJoint:
+			prepareWeld(constraints.getWeldJoints()[id.index], solverBodies, biasRate, warmStarting);
+			break;
+		case ConstraintType::SoftSpring:
+			prepareSoftSpring(constraints.getSoftSprings()[id.index], solverBodies, solveTime, maxSpringFrequency, warmStarting);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void JointSolver::warmStart(const std::vector<ConstraintId>& joints, size_t first, size_t last)
+{
+	std::vector<SolverBody>& bodies = *solverBodies;
+
+	for (size_t j = first; j < last; j++)
+	{
+		const ConstraintId& id = joints[j];
+		switch (id.type)
+		{
+		case ConstraintType::RevoluteJoint:
+		{
+			const RevoluteJoint& joint = constraints->getRevoluteJoints()[id.index];
+			applyLinearImpulse(bodies[joint.indexA], bodies[joint.indexB], joint.rA, joint.rB, joint.impulse);
+			break;
+		}
+		case ConstraintType::DistanceJoint:
+		{
+			const DistanceJoint& joint = constraints->getDistanceJoints()[id.index];
+			applyLinearImpulse(bodies[joint.indexA], bodies[joint.indexB], joint.rA, joint.rB, joint.axis * joint.impulse);
+			break;
+		}
+		case ConstraintType::PrismaticJoint:
+		{
+			const PrismaticJoint& joint = constraints->getPrismaticJoints()[id.index];
+			glm::vec2 impulse = joint.perpendicular * joint.impulse.x;
+			float angularA = joint.impulse.x * joint.s1 + joint.impulse.y;
+			float angularB = joint.impulse.x * joint.s2 + joint.impulse.y;
+			applyImpulse(bodies[joint.indexA], bodies[joint.indexB], impulse, angularA, angularB);
+			break;
+		}
+		case ConstraintType::WeldJoint:
+		{
+			const WeldJoint& joint = constraints->getWeldJoints()[id.index];
+			glm::vec2 impulse(joint.impulse);
+			float angularA = CoreMath::cross(joint.rA, impulse) + joint.impulse.z;
+			float angularB = CoreMath::cross(joint.rB, impulse) + joint.impulse.z;
+			applyImpulse(bodies[joint.indexA], bodies[joint.indexB], impulse, angularA, angularB);
+			break;
+		}
+		case ConstraintType::SoftSpring:
+		{
+			const SoftSpringJoint& joint = constraints->getSoftSprings()[id.index];
+			applyLinearImpulse(bodies[joint.indexA], bodies[joint.indexB], joint.rA, joint.rB, joint.axis * joint.impulse);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+void JointSolver::solveVelocities(const std::vector<ConstraintId>& joints, size_t first, size_t last, bool useBias)
+{
+	std::vector<SolverBody>& bodies = *solverBodies;
+	const float biasScale = useBias ? 1.0f : 0.0f;
+
+	for (size_t j = first; j < last; j++)
+	{
+		const ConstraintId& id = joints[j];
+		switch (id.type)
+		{
+		case ConstraintType::RevoluteJoint:
+		{
+			RevoluteJoint& joint = constraints->getRevoluteJoints()[id.index];
+			SolverBody& bodyA = bodies[joint.indexA];
+			SolverBody& bodyB = bodies[joint.indexB];
+
+			glm::vec2 velocityError = getPointVelocity(bodyB, joint.rB) - getPointVelocity(bodyA, joint.rA) + joint.bias * biasScale;
+			glm::vec2 impulse = -(joint.mass * velocityError);
+			joint.impulse += impulse;
+
+			applyLinearImpulse(bodyA, bodyB, joint.rA, joint.rB, impulse);
+			break;
+		}
+		case ConstraintType::DistanceJoint:
+		{
+			DistanceJoint& joint = constraints->getDistanceJoints()[id.index];
+			SolverBody& bodyA = bodies[joint.indexA];
+			SolverBody& bodyB = bodies[joint.indexB];
+
+			glm::vec2 relativeVelocity = getPointVelocity(bodyB, joint.rB) - getPointVelocity(bodyA, joint.rA);
+			float impulse = -joint.mass * (glm::dot(relativeVelocity, joint.axis) + joint.bias * biasScale);
+			joint.impulse += impulse;
+
+			applyLinearImpulse(bodyA, bodyB, joint.rA, joint.rB, joint.axis * impulse);
+			break;
+		}
+		case ConstraintType::PrismaticJoint:
+		{
+			PrismaticJoint& joint = constraints->getPrismaticJoints()[id.index];
+			SolverBody& bodyA = bodies[joint.indexA];
+			SolverBody& bodyB = bodies[joint.indexB];
+
+			glm::vec2 velocityError;
+			velocityError.x = glm::dot(joint.perpendicular, bodyB.velocity - bodyA.velocity) + joint.s2 * bodyB.angularVelocity - joint.s1 * bodyA.angularVelocity;
+			velocityError.y = bodyB.angularVelocity - bodyA.angularVelocity;
+			velocityError += joint.bias * biasScale;
+
+			glm::vec2 impulse = -(joint.mass * velocityError);
+			joint.impulse += impulse;
+
+			float angularA = impulse.x * joint.s1 + impulse.y;
+			float angularB = impulse.x * joint.s2 + impulse.y;
+			applyImpulse(bodyA, bodyB, joint.perpendicular * impulse.x, angularA, angularB);
+			break;
+		}
+		case ConstraintType::WeldJoint:
+		{
+			WeldJoint& joint = constraints->getWeldJoints()[id.index];
+			SolverBody& bodyA = bodies[joint.indexA];
+			SolverBody& bodyB = bodies[joint.indexB];
+
+			glm::vec2 linearError = getPointVelocity(bodyB, joint.rB) - getPointVelocity(bodyA, joint.rA);
+			glm::vec3 velocityError = glm::vec3(linearError, bodyB.angularVelocity - bodyA.angularVelocity) + joint.bias * biasScale;
+
+			glm::vec3 impulse = -(joint.mass * velocityError);
+			joint.impulse += impulse;
+
+			glm::vec2 linearImpulse(impulse);
+			float angularA = CoreMath::cross(joint.rA, linearImpulse) + impulse.z;
+			float angularB = CoreMath::cross(joint.rB, linearImpulse) + impulse.z;
+			applyImpulse(bodyA, bodyB, linearImpulse, angularA, angularB);
+			break;
+		}
+		case ConstraintType::SoftSpring:
+		{
+			SoftSpringJoint& joint = constraints->getSoftSprings()[id.index];
+			SolverBody& bodyA = bodies[joint.indexA];
+			SolverBody& bodyB = bodies[joint.indexB];
+
+			// Linear estimate of current stretch, deltas are zero, unless step is substepped
+			glm::vec2 anchorShift = (bodyB.deltaPosition + perpendicular(joint.rB) * bodyB.deltaRotation) - (bodyA.deltaPosition + perpendicular(joint.rA) * bodyA.deltaRotation);
+			float stretch = joint.stretch + glm::dot(anchorShift, joint.axis);
+
+			glm::vec2 relativeVelocity = getPointVelocity(bodyB, joint.rB) - getPointVelocity(bodyA, joint.rA);
+			float velocity = glm::dot(relativeVelocity, joint.axis);
+			float impulse = -joint.mass * joint.massScale * (velocity + joint.biasRate * stretch) - joint.impulseScale * joint.impulse;
+			joint.impulse += impulse;
+
+			applyLinearImpulse(bodyA, bodyB, joint.rA, joint.rB, joint.axis * impulse);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+const std::vector<ConstraintId>& JointSolver::getActiveJoints() const
+{
+	return activeJoints;
+}
+
+const std::vector<unsigned int>& JointSolver::getActiveBodies() const
+{
+	return activeBodies;
+}
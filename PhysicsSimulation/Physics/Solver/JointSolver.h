@@ -0,0 +1,37 @@
+#pragma once
+#include "ContactSolver.h"
+#include "Physics/Constraints/ConstraintStorage.h"
+
+#include <vector>
+
+// Solves joints with accumulated impulses on the same solver bodies, that contacts use, so both converge in one iteration loop
+class JointSolver
+{
+	// Part of position error, that is removed per step
+	const float POSITION_CORRECTION_PERCENT = 0.2f;
+
+	// Substeps solve joints once, so stiffer springs diverge in long chains. Limit is part of substep rate, same as of soft contacts
+	const float MAX_SUBSTEP_SPRING_FREQUENCY_RATIO = 0.25f;
+
+	ConstraintStorage* constraints = nullptr;
+	std::vector<SolverBody>* solverBodies = nullptr;
+
+	std::vector<ConstraintId> activeJoints;
+	std::vector<unsigned int> activeBodies;
+public:
+	// Computes arms, masses and position bias of joints, that have an awake body. Joints are solved on given solver bodies until next prepare.
+	// Solve time is time between velocity solves, substep time when step is substepped, soft springs are tuned for it
+	void prepare(ConstraintStorage& constraints, std::vector<SolverBody>& solverBodies, float stepTime, float solveTime, bool warmStarting);
+
+	// Following methods work on joints in range [first, last) of given list
+	void warmStart(const std::vector<ConstraintId>& joints, size_t first, size_t last);
+
+	// Without bias joints only keep relative velocity, position error isn't corrected. Soft springs always pull, it's their force, not correction
+	void solveVelocities(const std::vector<ConstraintId>& joints, size_t first, size_t last, bool useBias);
+
+	// Joints with at least one awake body in order of types
+	const std::vector<ConstraintId>& getActiveJoints() const;
+
+	// Solver body indices of both bodies of every active joint. Modes, that keep velocities outside of solver bodies, sync only these
+	const std::vector<unsigned int>& getActiveBodies() const;
+};
@@ -0,0 +1,297 @@
+#include "SimdContactSolver.h"
+
+#include "Core/Profiler.h"
+
+#include <math.h>
+#include <algorithm>
+
+#ifdef SIMD_SSE2
+#include <emmintrin.h>
+
+namespace
+{
+	inline __m128 gather(const float* values, const unsigned int* slots)
+	{
+		return _mm_setr_ps(values[slots[0]], values[slots[1]], values[slots[2]], values[slots[3]]);
+	}
+
+	inline void scatter(float* values, const unsigned int* slots, __m128 v)
+	{
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, v);
+		for (size_t i = 0; i < 4; i++)
+		{
+			values[slots[i]] = lanes[i];
+		}
+	}
+}
+#endif
+
+void SimdContactSolver::addRow(ContactConstraint& constraint, ContactPoint& point)
+{
+	const unsigned int slotA = constraint.indexA + 1;
+	const unsigned int slotB = constraint.indexB + 1;
+	const bool isAStatic = invMass[slotA] == 0.0f;
+	const bool isBStatic = invMass[slotB] == 0.0f;
+
+	// Find batch, that doesn't touch dynamic bodies of this row yet. Static bodies are never written, so they can repeat
+	ContactBatch* target = nullptr;
+	size_t searchStart = batches.size() > BATCH_SEARCH_WINDOW ? batches.size() - BATCH_SEARCH_WINDOW : 0;
+	for (size_t b = searchStart; b < batches.size() && target == nullptr; b++)
+	{
+		ContactBatch& batch = batches[b];
+		if (batch.countOfLanes == CONTACT_BATCH_WIDTH)
+		{
+			continue;
+		}
+
+		bool isFree = true;
+		for (unsigned int lane = 0; lane < batch.countOfLanes; lane++)
+		{
+			if ((!isAStatic && (batch.bodyA[lane] == slotA || batch.bodyB[lane] == slotA)) ||
+				(!isBStatic && (batch.bodyA[lane] == slotB || batch.bodyB[lane] == slotB)))
+			{
+				isFree = false;
+				break;
+			}
+		}
+
+		if (isFree)
+		{
+			target = &batch;
+		}
+	}
+
+	if (target == nullptr)
+	{
+		// Empty lanes point at slot 0 and have zero masses, so solving them changes nothing
+		batches.emplace_back();
+		target = &batches.back();
+	}
+
+	unsigned int lane = target->countOfLanes++;
+	target->normalX[lane] = constraint.normal.x;
+	target->normalY[lane] = constraint.normal.y;
+	target->r1PerpX[lane] = point.r1Perp.x;
+	target->r1PerpY[lane] = point.r1Perp.y;
+	target->r2PerpX[lane] = point.r2Perp.x;
+	target->r2PerpY[lane] = point.r2Perp.y;
+	target->normalMass[lane] = point.normalMass;
+	target->tangentMass[lane] = point.tangentMass;
+	target->normalImpulse[lane] = point.normalImpulse;
+	target->tangentImpulse[lane] = point.tangentImpulse;
+	target->staticFriction[lane] = constraint.staticFriction;
+	target->dynamicFriction[lane] = constraint.dynamicFriction;
+	target->bodyA[lane] = slotA;
+	target->bodyB[lane] = slotB;
+	target->points[lane] = &point;
+}
+
+void SimdContactSolver::build(std::vector<ContactConstraint>& constraints, const std::vector<SolverBody>& bodies)
+{
+	PROFILE_FUNCTION();
+
+	const size_t countOfSlots = bodies.size() + 1;
+	velocityX.assign(countOfSlots, 0.0f);
+	velocityY.assign(countOfSlots, 0.0f);
+	angularVelocity.assign(countOfSlots, 0.0f);
+	invMass.assign(countOfSlots, 0.0f);
+	invInertia.assign(countOfSlots, 0.0f);
+
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		const SolverBody& body = bodies[i];
+		const size_t slot = i + 1;
+		velocityX[slot] = body.velocity.x;
+		velocityY[slot] = body.velocity.y;
+		angularVelocity[slot] = body.angularVelocity;
+		invMass[slot] = body.invMass;
+		invInertia[slot] = body.invInertia;
+	}
+
+	batches.clear();
+	for (auto& constraint : constraints)
+	{
+		for (unsigned int i = 0; i < constraint.countOfContacts; i++)
+		{
+			addRow(constraint, constraint.points[i]);
+		}
+	}
+}
+
+void SimdContactSolver::solveBatch(ContactBatch& batch)
+{
+#ifdef SIMD_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	const __m128 nx = _mm_load_ps(batch.normalX);
+	const __m128 ny = _mm_load_ps(batch.normalY);
+	const __m128 r1x = _mm_load_ps(batch.r1PerpX);
+	const __m128 r1y = _mm_load_ps(batch.r1PerpY);
+	const __m128 r2x = _mm_load_ps(batch.r2PerpX);
+	const __m128 r2y = _mm_load_ps(batch.r2PerpY);
+
+	// Gather
+	__m128 vAx = gather(velocityX.data(), batch.bodyA);
+	__m128 vAy = gather(velocityY.data(), batch.bodyA);
+	__m128 wA = gather(angularVelocity.data(), batch.bodyA);
+	__m128 vBx = gather(velocityX.data(), batch.bodyB);
+	__m128 vBy = gather(velocityY.data(), batch.bodyB);
+	__m128 wB = gather(angularVelocity.data(), batch.bodyB);
+	const __m128 imA = gather(invMass.data(), batch.bodyA);
+	const __m128 iiA = gather(invInertia.data(), batch.bodyA);
+	const __m128 imB = gather(invMass.data(), batch.bodyB);
+	const __m128 iiB = gather(invInertia.data(), batch.bodyB);
+
+	// Applies impulse (px, py) to both bodies of every lane
+	auto applyImpulse = [&](__m128 px, __m128 py)
+	{
+		vAx = _mm_sub_ps(vAx, _mm_mul_ps(px, imA));
+		vAy = _mm_sub_ps(vAy, _mm_mul_ps(py, imA));
+		wA = _mm_sub_ps(wA, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(r1x, px), _mm_mul_ps(r1y, py)), iiA));
+		vBx = _mm_add_ps(vBx, _mm_mul_ps(px, imB));
+		vBy = _mm_add_ps(vBy, _mm_mul_ps(py, imB));
+		wB = _mm_add_ps(wB, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(r2x, px), _mm_mul_ps(r2y, py)), iiB));
+	};
+
+	// Relative velocity of contact points
+	auto relativeVelocity = [&](__m128& dvx, __m128& dvy)
+	{
+		dvx = _mm_sub_ps(_mm_add_ps(vBx, _mm_mul_ps(r2x, wB)), _mm_add_ps(vAx, _mm_mul_ps(r1x, wA)));
+		dvy = _mm_sub_ps(_mm_add_ps(vBy, _mm_mul_ps(r2y, wB)), _mm_add_ps(vAy, _mm_mul_ps(r1y, wA)));
+	};
+
+	__m128 dvx, dvy;
+
+	// Normal
+	relativeVelocity(dvx, dvy);
+	__m128 vn = _mm_add_ps(_mm_mul_ps(dvx, nx), _mm_mul_ps(dvy, ny));
+	__m128 oldNormal = _mm_load_ps(batch.normalImpulse);
+	__m128 newNormal = _mm_max_ps(_mm_sub_ps(oldNormal, _mm_mul_ps(vn, _mm_load_ps(batch.normalMass))), zero);
+	_mm_store_ps(batch.normalImpulse, newNormal);
+
+	__m128 dn = _mm_sub_ps(newNormal, oldNormal);
+	applyImpulse(_mm_mul_ps(nx, dn), _mm_mul_ps(ny, dn));
+
+	// Friction. Tangent is (-ny, nx)
+	relativeVelocity(dvx, dvy);
+	__m128 vt = _mm_sub_ps(_mm_mul_ps(dvy, nx), _mm_mul_ps(dvx, ny));
+	__m128 oldTangent = _mm_load_ps(batch.tangentImpulse);
+	__m128 newTangent = _mm_sub_ps(oldTangent, _mm_mul_ps(vt, _mm_load_ps(batch.tangentMass)));
+
+	// Outside of static cone contact slides, then impulse is clamped by dynamic friction
+	__m128 maxStatic = _mm_mul_ps(newNormal, _mm_load_ps(batch.staticFriction));
+	__m128 maxDynamic = _mm_mul_ps(newNormal, _mm_load_ps(batch.dynamicFriction));
+	__m128 isSliding = _mm_cmpgt_ps(_mm_andnot_ps(signMask, newTangent), maxStatic);
+	__m128 clamped = _mm_max_ps(_mm_min_ps(newTangent, maxDynamic), _mm_sub_ps(zero, maxDynamic));
+	newTangent = _mm_or_ps(_mm_and_ps(isSliding, clamped), _mm_andnot_ps(isSliding, newTangent));
+	_mm_store_ps(batch.tangentImpulse, newTangent);
+
+	__m128 dt = _mm_sub_ps(newTangent, oldTangent);
+	applyImpulse(_mm_sub_ps(zero, _mm_mul_ps(ny, dt)), _mm_mul_ps(nx, dt));
+
+	// Scatter. Lanes don't share dynamic bodies, so writes don't overlap
+	scatter(velocityX.data(), batch.bodyA, vAx);
+	scatter(velocityY.data(), batch.bodyA, vAy);
+	scatter(angularVelocity.data(), batch.bodyA, wA);
+	scatter(velocityX.data(), batch.bodyB, vBx);
+	scatter(velocityY.data(), batch.bodyB, vBy);
+	scatter(angularVelocity.data(), batch.bodyB, wB);
+#else
+	for (unsigned int lane = 0; lane < batch.countOfLanes; lane++)
+	{
+		const unsigned int a = batch.bodyA[lane];
+		const unsigned int b = batch.bodyB[lane];
+		const glm::vec2 n(batch.normalX[lane], batch.normalY[lane]);
+		const glm::vec2 t(-n.y, n.x);
+		const glm::vec2 r1(batch.r1PerpX[lane], batch.r1PerpY[lane]);
+		const glm::vec2 r2(batch.r2PerpX[lane], batch.r2PerpY[lane]);
+
+		auto applyImpulse = [&](const glm::vec2& impulse)
+		{
+			velocityX[a] -= impulse.x * invMass[a];
+			velocityY[a] -= impulse.y * invMass[a];
+			angularVelocity[a] -= glm::dot(r1, impulse) * invInertia[a];
+			velocityX[b] += impulse.x * invMass[b];
+			velocityY[b] += impulse.y * invMass[b];
+			angularVelocity[b] += glm::dot(r2, impulse) * invInertia[b];
+		};
+		auto relativeVelocity = [&]()
+		{
+			return glm::vec2(velocityX[b], velocityY[b]) + r2 * angularVelocity[b] - glm::vec2(velocityX[a], velocityY[a]) - r1 * angularVelocity[a];
+		};
+
+		float oldNormal = batch.normalImpulse[lane];
+		float newNormal = fmaxf(oldNormal - glm::dot(relativeVelocity(), n) * batch.normalMass[lane], 0.0f);
+		batch.normalImpulse[lane] = newNormal;
+		applyImpulse(n * (newNormal - oldNormal));
+
+		float oldTangent = batch.tangentImpulse[lane];
+		float newTangent = oldTangent - glm::dot(relativeVelocity(), t) * batch.tangentMass[lane];
+		if (fabsf(newTangent) > newNormal * batch.staticFriction[lane])
+		{
+			float maxFriction = newNormal * batch.dynamicFriction[lane];
+			newTangent = glm::clamp(newTangent, -maxFriction, maxFriction);
+		}
+		batch.tangentImpulse[lane] = newTangent;
+		applyImpulse(t * (newTangent - oldTangent));
+	}
+#endif
+}
+
+void SimdContactSolver::solveVelocities()
+{
+	for (auto& batch : batches)
+	{
+		solveBatch(batch);
+	}
+}
+
+void SimdContactSolver::storeVelocities(std::vector<SolverBody>& bodies, const std::vector<unsigned int>& bodyIndices) const
+{
+	for (unsigned int index : bodyIndices)
+	{
+		const size_t slot = index + 1;
+		bodies[index].velocity = { velocityX[slot], velocityY[slot] };
+		bodies[index].angularVelocity = angularVelocity[slot];
+	}
+}
+
+void SimdContactSolver::loadVelocities(const std::vector<SolverBody>& bodies, const std::vector<unsigned int>& bodyIndices)
+{
+	for (unsigned int index : bodyIndices)
+	{
+		const size_t slot = index + 1;
+		velocityX[slot] = bodies[index].velocity.x;
+		velocityY[slot] = bodies[index].velocity.y;
+		angularVelocity[slot] = bodies[index].angularVelocity;
+	}
+}
+
+void SimdContactSolver::finish(std::vector<SolverBody>& bodies)
+{
+	PROFILE_FUNCTION();
+
+	for (size_t i = 0; i < bodies.size(); i++)
+	{
+		SolverBody& body = bodies[i];
+		if (body.invMass == 0.0f)
+		{
+			continue;
+		}
+
+		const size_t slot = i + 1;
+		body.velocity = { velocityX[slot], velocityY[slot] };
+		body.angularVelocity = angularVelocity[slot];
+	}
+
+	for (const auto& batch : batches)
+	{
+		for (unsigned int lane = 0; lane < batch.countOfLanes; lane++)
+		{
+			batch.points[lane]->normalImpulse = batch.normalImpulse[lane];
+			batch.points[lane]->tangentImpulse = batch.tangentImpulse[lane];
+		}
+	}
+}
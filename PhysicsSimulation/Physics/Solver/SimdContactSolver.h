@@ -0,0 +1,51 @@
+#pragma once
+#include "ContactSolver.h"
+#include "Core/SimdMath.h"
+
+#include <vector>
+
+constexpr size_t CONTACT_BATCH_WIDTH = 4;
+
+// Contact points of different constraints, packed as SoA rows. Lanes of one batch never share a dynamic body, so they can be solved at once
+struct alignas(16) ContactBatch
+{
+	float normalX[CONTACT_BATCH_WIDTH], normalY[CONTACT_BATCH_WIDTH];
+	float r1PerpX[CONTACT_BATCH_WIDTH], r1PerpY[CONTACT_BATCH_WIDTH];
+	float r2PerpX[CONTACT_BATCH_WIDTH], r2PerpY[CONTACT_BATCH_WIDTH];
+	float normalMass[CONTACT_BATCH_WIDTH], tangentMass[CONTACT_BATCH_WIDTH];
+	float normalImpulse[CONTACT_BATCH_WIDTH], tangentImpulse[CONTACT_BATCH_WIDTH];
+	float staticFriction[CONTACT_BATCH_WIDTH], dynamicFriction[CONTACT_BATCH_WIDTH];
+
+	unsigned int bodyA[CONTACT_BATCH_WIDTH], bodyB[CONTACT_BATCH_WIDTH]; // Slots in solver's body arrays
+	ContactPoint* points[CONTACT_BATCH_WIDTH]; // nullptr for empty lanes
+
+	unsigned int countOfLanes;
+};
+
+// Velocity solver, that works on batches of contacts with SSE. Constraints must be prepared and warm started by ContactSolver beforehand
+class SimdContactSolver
+{
+	// How many last batches are checked for free lane before new batch is started
+	const size_t BATCH_SEARCH_WINDOW = 8;
+
+	std::vector<ContactBatch> batches;
+
+	// Body velocities as SoA. Slot 0 is an empty body for unused lanes, other slots are body index + 1
+	std::vector<float> velocityX, velocityY, angularVelocity;
+	std::vector<float> invMass, invInertia;
+
+	void addRow(ContactConstraint& constraint, ContactPoint& point);
+	void solveBatch(ContactBatch& batch);
+public:
+	// Gathers solver body velocities and packs contact points into batches
+	void build(std::vector<ContactConstraint>& constraints, const std::vector<SolverBody>& bodies);
+
+	void solveVelocities();
+
+	// Other constraints are solved on solver bodies between SIMD iterations, so velocities of their bodies are copied both ways
+	void storeVelocities(std::vector<SolverBody>& bodies, const std::vector<unsigned int>& bodyIndices) const;
+	void loadVelocities(const std::vector<SolverBody>& bodies, const std::vector<unsigned int>& bodyIndices);
+
+	// Scatters velocities back into solver bodies and impulses back into contact points
+	void finish(std::vector<SolverBody>& bodies);
+};
@@ -0,0 +1,624 @@
+#include "XpbdSolver.h"
+
+#include "Core/CoreMath.h"
+#include "Core/Profiler.h"
+
+#include <math.h>
+
+namespace
+{
+	inline glm::vec2 perpendicular(const glm::vec2& v)
+	{
+		return glm::vec2(-v.y, v.x);
+	}
+
+	// Anchors of constraints are local to body's position, that is center of mass without offset
+	inline glm::vec2 getWorldAnchor(const XpbdBody& body, const glm::vec2& localAnchor)
+	{
+		return body.position - body.centerOffset + CoreMath::rotatePoint(localAnchor, body.rotation);
+	}
+
+	inline glm::vec2 getPreviousWorldAnchor(const XpbdBody& body, const glm::vec2& localAnchor)
+	{
+		return body.previousPosition - body.centerOffset + CoreMath::rotatePoint(localAnchor, body.previousRotation);
+	}
+
+	// Inverse mass of body at arm r along direction n
+	inline float getGeneralizedInverseMass(const XpbdBody& body, const glm::vec2& r, const glm::vec2& n)
+	{
+		float rn = CoreMath::cross(r, n);
+		return body.invMass + body.invInertia * rn * rn;
+	}
+
+	// Moves body B along correction and body A against it
+	inline void applyPositionCorrection(XpbdBody& bodyA, XpbdBody& bodyB, const glm::vec2& rA, const glm::vec2& rB, const glm::vec2& correction)
+	{
+		bodyA.position -= correction * bodyA.invMass;
+		bodyA.rotation -= CoreMath::cross(rA, correction) * bodyA.invInertia;
+		bodyB.position += correction * bodyB.invMass;
+		bodyB.rotation += CoreMath::cross(rB, correction) * bodyB.invInertia;
+	}
+
+	// Linear estimate of how far point at arm r moved from given pose
+	inline glm::vec2 getPointShift(const XpbdBody& body, const glm::vec2& r, const glm::vec2& fromPosition, float fromRotation)
+	{
+		return body.position - fromPosition + perpendicular(r) * (body.rotation - fromRotation);
+	}
+
+	// Contact anchors coincided at start of step, so separation changes by their relative shift
+	inline float getSeparation(const XpbdBody& bodyA, const XpbdBody& bodyB, const XpbdContactPoint& point, const glm::vec2& normal)
+	{
+		glm::vec2 shift = getPointShift(bodyB, point.rB, bodyB.startPosition, bodyB.startRotation) - getPointShift(bodyA, point.rA, bodyA.startPosition, bodyA.startRotation);
+		return point.separation + glm::dot(shift, normal);
+	}
+
+	inline glm::vec2 getRelativeVelocity(const XpbdBody& bodyA, const XpbdBody& bodyB, const glm::vec2& rA, const glm::vec2& rB)
+	{
+		return (bodyB.velocity + perpendicular(rB) * bodyB.angularVelocity) - (bodyA.velocity + perpendicular(rA) * bodyA.angularVelocity);
+	}
+
+	inline void applyVelocityCorrection(XpbdBody& bodyA, XpbdBody& bodyB, const glm::vec2& rA, const glm::vec2& rB, const glm::vec2& impulse)
+	{
+		bodyA.velocity -= impulse * bodyA.invMass;
+		bodyA.angularVelocity -= CoreMath::cross(rA, impulse) * bodyA.invInertia;
+		bodyB.velocity += impulse * bodyB.invMass;
+		bodyB.angularVelocity += CoreMath::cross(rB, impulse) * bodyB.invInertia;
+	}
+
+	// Projects positional constraint C along n, that grows, when anchor B moves along n. Compliance is already divided by squared substep time
+	inline float solvePositional(XpbdBody& bodyA, XpbdBody& bodyB, const glm::vec2& rA, const glm::vec2& rB, const glm::vec2& n, float C, float compliance)
+	{
+		float w = getGeneralizedInverseMass(bodyA, rA, n) + getGeneralizedInverseMass(bodyB, rB, n);
+		if (w + compliance == 0.0f)
+		{
+			return 0.0f;
+		}
+
+		float lambda = -C / (w + compliance);
+		applyPositionCorrection(bodyA, bodyB, rA, rB, n * lambda);
+		return lambda;
+	}
+
+	// Rigid constraint of relative rotation
+	inline void solveAngular(XpbdBody& bodyA, XpbdBody& bodyB, float C)
+	{
+		float w = bodyA.invInertia + bodyB.invInertia;
+		if (w == 0.0f)
+		{
+			return;
+		}
+
+		float lambda = -C / w;
+		bodyA.rotation -= lambda * bodyA.invInertia;
+		bodyB.rotation += lambda * bodyB.invInertia;
+	}
+
+	// Point to point constraint, that also keeps given distance
+	inline void solveDistance(XpbdBody& bodyA, XpbdBody& bodyB, const glm::vec2& localAnchorA, const glm::vec2& localAnchorB, float distance, float compliance)
+	{
+		glm::vec2 pA = getWorldAnchor(bodyA, localAnchorA);
+		glm::vec2 pB = getWorldAnchor(bodyB, localAnchorB);
+		glm::vec2 dpos = pB - pA;
+		float length = glm::length(dpos);
+		if (length == 0.0f)
+		{
+			// Coincident anchors have no direction
+			return;
+		}
+
+		solvePositional(bodyA, bodyB, pA - bodyA.position, pB - bodyB.position, dpos / length, length - distance, compliance);
+	}
+
+	// Sorts constraints by island of their awake body, constraints without island are dropped
+	template<typename IslandOf>
+	void sortByIsland(size_t count, size_t countOfIslands, IslandOf islandOf, std::vector<unsigned int>& sorted, std::vector<unsigned int>& offsets)
+	{
+		offsets.assign(countOfIslands + 1, 0);
+		for (size_t i = 0; i < count; i++)
+		{
+			unsigned int island = islandOf(i);
+			if (island != NO_ISLAND)
+			{
+				offsets[island + 1]++;
+			}
+		}
+
+		for (size_t i = 0; i < countOfIslands; i++)
+		{
+			offsets[i + 1] += offsets[i];
+		}
+
+		sorted.resize(offsets.back());
+		std::vector<unsigned int> cursors(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < count; i++)
+		{
+			unsigned int island = islandOf(i);
+			if (island != NO_ISLAND)
+			{
+				sorted[cursors[island]++] = (unsigned int)i;
+			}
+		}
+	}
+
+	inline unsigned int getIslandOfPair(const RigidBody* bodyA, const RigidBody* bodyB)
+	{
+		return bodyA->isAwake() ? bodyA->islandIndex : (bodyB->isAwake() ? bodyB->islandIndex : NO_ISLAND);
+	}
+}
+
+void XpbdSolver::prepare(const std::vector<CollisionManifold>& manifolds, const std::vector<RigidBody*>& bodies, ConstraintStorage& constraints, const std::vector<Island>& islands, const MaterialTable& materials, float restitutionThreshold)
+{
+	PROFILE_FUNCTION();
+
+	this->constraints = &constraints;
+
+	this->bodies.resize(bodies.size());
+	for (const auto& body : bodies)
+	{
+		XpbdBody& xpbdBody = this->bodies[body->bodyIndex];
+		const bool awake = body->isAwake();
+		xpbdBody.position = body->getCenterOfMass();
+		xpbdBody.rotation = body->getRotation();
+		xpbdBody.previousPosition = xpbdBody.position;
+		xpbdBody.previousRotation = xpbdBody.rotation;
+		xpbdBody.startPosition = xpbdBody.position;
+		xpbdBody.startRotation = xpbdBody.rotation;
+		xpbdBody.velocity = awake ? body->getVelocity() : glm::vec2(0.0f);
+		xpbdBody.angularVelocity = awake ? body->getAngularVelocity() : 0.0f;
+		xpbdBody.invMass = awake ? body->getInvMass() : 0.0f;
+		xpbdBody.invInertia = awake ? body->getInvInertia() : 0.0f;
+		xpbdBody.centerOffset = xpbdBody.position - body->getPosition();
+	}
+
+	contacts.resize(manifolds.size());
+	for (size_t m = 0; m < manifolds.size(); m++)
+	{
+		const CollisionManifold& manifold = manifolds[m];
+		XpbdContact& contact = contacts[m];
+
+		contact.indexA = manifold.bodyA->bodyIndex;
+		contact.indexB = manifold.bodyB->bodyIndex;
+		contact.normal = manifold.normal;
+		const MaterialPair& pair = materials.getPair(manifold.bodyA->material, manifold.bodyB->material);
+		contact.staticFriction = pair.staticFriction;
+		contact.dynamicFriction = pair.dynamicFriction;
+		contact.elasticity = pair.elasticity;
+		contact.countOfContacts = manifold.countOfContacts;
+		contact.normalLambdaSum = 0.0f;
+		contact.frictionSum = glm::vec2(0.0f);
+
+		const XpbdBody& bodyA = this->bodies[contact.indexA];
+		const XpbdBody& bodyB = this->bodies[contact.indexB];
+		for (unsigned int i = 0; i < manifold.countOfContacts; i++)
+		{
+			XpbdContactPoint& point = contact.points[i];
+			point.rA = manifold.contacts[i] - bodyA.position;
+			point.rB = manifold.contacts[i] - bodyB.position;
+			point.separation = manifold.separations[i];
+			point.normalLambda = 0.0f;
+			point.touched = false;
+
+			// Only contacts, that didn't overlap at start of step, bounce. Few substeps leave stacks a bit springy and their bounces would rock them
+			float approachVelocity = glm::dot(getRelativeVelocity(bodyA, bodyB, point.rA, point.rB), contact.normal);
+			bool bounces = point.separation >= 0.0f && approachVelocity < -restitutionThreshold;
+			point.restitutionVelocity = bounces ? -contact.elasticity * approachVelocity : 0.0f;
+		}
+	}
+
+	const SpringConstraints& springs = constraints.getSprings();
+	sortByIsland(springs.size(), islands.size(), [&springs](size_t i)
+		{
+			return getIslandOfPair(springs.bodiesA[i], springs.bodiesB[i]);
+		}, islandSprings, springOffsets);
+
+	const AxisConstraints& axisConstraints = constraints.getAxisConstraints();
+	sortByIsland(axisConstraints.size(), islands.size(), [&axisConstraints](size_t i)
+		{
+			const RigidBody* body = axisConstraints.bodies[i];
+			return body->isAwake() ? body->islandIndex : NO_ISLAND;
+		}, islandAxes, axisOffsets);
+}
+
+void XpbdSolver::solveIsland(const Island& island, size_t islandIndex, const std::vector<RigidBody*>& islandBodies, const std::vector<ConstraintId>& islandJoints, const glm::vec2& gravity, float timeStep, unsigned int substepCount)
+{
+	const float substepTime = timeStep / substepCount;
+	const size_t firstBody = island.firstBody;
+	const size_t lastBody = firstBody + island.countOfBodies;
+	const size_t first = island.firstManifold;
+	const size_t last = first + island.countOfManifolds;
+	const size_t firstJoint = island.firstJoint;
+	const size_t lastJoint = firstJoint + island.countOfJoints;
+
+	for (unsigned int substep = 0; substep < substepCount; substep++)
+	{
+		integrate(islandBodies, firstBody, lastBody, gravity, substepTime);
+
+		// Contacts go after joints, so bodies end substep without overlap. Axis locks are exact, so they go last
+		solveJoints(islandJoints, firstJoint, lastJoint, substepTime);
+		solveSprings(islandIndex, substepTime);
+		solveContactPositions(first, last, substepTime);
+		solveAxisLocks(islandIndex);
+
+		updateVelocities(islandBodies, firstBody, lastBody, substepTime);
+		solveContactVelocities(first, last, substepTime);
+	}
+
+	// Bounce is applied once per step, otherwise every substep would push landed contacts with approach velocity again
+	applyRestitution(first, last);
+}
+
+void XpbdSolver::integrate(const std::vector<RigidBody*>& islandBodies, size_t first, size_t last, const glm::vec2& acceleration, float substepTime)
+{
+	for (size_t i = first; i < last; i++)
+	{
+		XpbdBody& body = bodies[islandBodies[i]->bodyIndex];
+		body.previousPosition = body.position;
+		body.previousRotation = body.rotation;
+
+		body.velocity += acceleration * substepTime;
+		body.position += body.velocity * substepTime;
+		body.rotation += body.angularVelocity * substepTime;
+	}
+}
+
+void XpbdSolver::solveContactPositions(size_t first, size_t last, float substepTime)
+{
+	// Depth projected in one substep is limited, so deep overlap is removed over several substeps
+	const float maxPushout = MAX_PUSHOUT_VELOCITY * substepTime;
+
+	for (size_t c = first; c < last; c++)
+	{
+		XpbdContact& contact = contacts[c];
+		XpbdBody& bodyA = bodies[contact.indexA];
+		XpbdBody& bodyB = bodies[contact.indexB];
+		const glm::vec2& normal = contact.normal;
+
+		// Static friction cancels tangential shift of manifold since start of step, while all friction of step fits into cone of normal force pushed so far.
+		// Single point doesn't get enough normal force to hold the shift alone. Friction goes first, so projection of normals ends the substep
+		if (contact.normalLambdaSum > 0.0f)
+		{
+			glm::vec2 rA(0.0f), rB(0.0f);
+			for (unsigned int i = 0; i < contact.countOfContacts; i++)
+			{
+				rA += contact.points[i].rA;
+				rB += contact.points[i].rB;
+			}
+			rA /= (float)contact.countOfContacts;
+			rB /= (float)contact.countOfContacts;
+
+			glm::vec2 shift = getPointShift(bodyB, rB, bodyB.startPosition, bodyB.startRotation) - getPointShift(bodyA, rA, bodyA.startPosition, bodyA.startRotation);
+			glm::vec2 tangentShift = shift - normal * glm::dot(shift, normal);
+			float tangentLength = glm::length(tangentShift);
+			if (tangentLength > 0.0f)
+			{
+				glm::vec2 tangent = tangentShift / tangentLength;
+				float w = getGeneralizedInverseMass(bodyA, rA, tangent) + getGeneralizedInverseMass(bodyB, rB, tangent);
+				if (w > 0.0f)
+				{
+					glm::vec2 correction = tangent * (-tangentLength / w);
+					glm::vec2 frictionSum = contact.frictionSum + correction;
+					if (glm::length(frictionSum) <= contact.staticFriction * contact.normalLambdaSum)
+					{
+						contact.frictionSum = frictionSum;
+						applyPositionCorrection(bodyA, bodyB, rA, rB, correction);
+					}
+				}
+			}
+		}
+
+		float separations[2] = {};
+		for (unsigned int i = 0; i < contact.countOfContacts; i++)
+		{
+			XpbdContactPoint& point = contact.points[i];
+			point.normalLambda = 0.0f;
+			separations[i] = fmaxf(getSeparation(bodyA, bodyB, point, normal), -maxPushout);
+		}
+
+		// Projecting points one by one tilts body towards the first one, so resting pairs are projected together
+		if (contact.countOfContacts != 2 || separations[0] >= 0.0f || separations[1] >= 0.0f || !solveNormalBlock(contact, separations))
+		{
+			for (unsigned int i = 0; i < contact.countOfContacts; i++)
+			{
+				XpbdContactPoint& point = contact.points[i];
+				float separation = fmaxf(getSeparation(bodyA, bodyB, point, normal), -maxPushout);
+				if (separation < 0.0f)
+				{
+					point.normalLambda = solvePositional(bodyA, bodyB, point.rA, point.rB, normal, separation, 0.0f);
+				}
+			}
+		}
+
+		for (unsigned int i = 0; i < contact.countOfContacts; i++)
+		{
+			contact.normalLambdaSum += contact.points[i].normalLambda;
+		}
+	}
+}
+
+bool XpbdSolver::solveNormalBlock(XpbdContact& contact, const float separations[2])
+{
+	XpbdBody& bodyA = bodies[contact.indexA];
+	XpbdBody& bodyB = bodies[contact.indexB];
+	const glm::vec2& normal = contact.normal;
+	const XpbdContactPoint& point1 = contact.points[0];
+	const XpbdContactPoint& point2 = contact.points[1];
+
+	float rn1A = CoreMath::cross(point1.rA, normal);
+	float rn1B = CoreMath::cross(point1.rB, normal);
+	float rn2A = CoreMath::cross(point2.rA, normal);
+	float rn2B = CoreMath::cross(point2.rB, normal);
+
+	const float invMassSum = bodyA.invMass + bodyB.invMass;
+	float k11 = invMassSum + rn1A * rn1A * bodyA.invInertia + rn1B * rn1B * bodyB.invInertia;
+	float k22 = invMassSum + rn2A * rn2A * bodyA.invInertia + rn2B * rn2B * bodyB.invInertia;
+	float k12 = invMassSum + rn1A * rn2A * bodyA.invInertia + rn1B * rn2B * bodyB.invInertia;
+
+	// Badly conditioned pair is projected point by point
+	float determinant = k11 * k22 - k12 * k12;
+	if (k11 * k11 >= MAX_BLOCK_CONDITION_NUMBER * determinant)
+	{
+		return false;
+	}
+
+	// Both points must push, otherwise one of them isn't in contact after projection
+	float invDeterminant = 1.0f / determinant;
+	float lambda1 = (-k22 * separations[0] + k12 * separations[1]) * invDeterminant;
+	float lambda2 = (k12 * separations[0] - k11 * separations[1]) * invDeterminant;
+	if (lambda1 < 0.0f || lambda2 < 0.0f)
+	{
+		return false;
+	}
+
+	contact.points[0].normalLambda = lambda1;
+	contact.points[1].normalLambda = lambda2;
+	applyPositionCorrection(bodyA, bodyB, point1.rA, point1.rB, normal * lambda1);
+	applyPositionCorrection(bodyA, bodyB, point2.rA, point2.rB, normal * lambda2);
+	return true;
+}
+
+void XpbdSolver::solveSprings(size_t islandIndex, float substepTime)
+{
+	const SpringConstraints& springs = constraints->getSprings();
+	const float invSubstepTimeSquared = 1.0f / (substepTime * substepTime);
+
+	for (unsigned int s = springOffsets[islandIndex]; s < springOffsets[islandIndex + 1]; s++)
+	{
+		unsigned int i = islandSprings[s];
+		if (springs.stiffnesses[i] <= 0.0f)
+		{
+			continue;
+		}
+
+		// Spring force is stiffness times stretch, so compliance is inverse of stiffness
+		float compliance = invSubstepTimeSquared / springs.stiffnesses[i];
+		solveDistance(bodies[springs.bodiesA[i]->bodyIndex], bodies[springs.bodiesB[i]->bodyIndex], springs.localAnchorsA[i], springs.localAnchorsB[i], springs.distances[i], compliance);
+	}
+}
+
+void XpbdSolver::solveJoints(const std::vector<ConstraintId>& joints, size_t first, size_t last, float substepTime)
+{
+	for (size_t j = first; j < last; j++)
+	{
+		const ConstraintId& id = joints[j];
+		switch (id.type)
+		{
+		case ConstraintType::RevoluteJoint:
+		{
+			const RevoluteJoint& joint = constraints->getRevoluteJoints()[id.index];
+			solveDistance(bodies[joint.bodyA->bodyIndex], bodies[joint.bodyB->bodyIndex], joint.localAnchorA, joint.localAnchorB, 0.0f, 0.0f);
+			break;
+		}
+		case ConstraintType::DistanceJoint:
+		{
+			const DistanceJoint& joint = constraints->getDistanceJoints()[id.index];
+			solveDistance(bodies[joint.bodyA->bodyIndex], bodies[joint.bodyB->bodyIndex], joint.localAnchorA, joint.localAnchorB, joint.length, 0.0f);
+			break;
+		}
+		case ConstraintType::PrismaticJoint:
+		{
+			const PrismaticJoint& joint = constraints->getPrismaticJoints()[id.index];
+			XpbdBody& bodyA = bodies[joint.bodyA->bodyIndex];
+			XpbdBody& bodyB = bodies[joint.bodyB->bodyIndex];
+			solveAngular(bodyA, bodyB, bodyB.rotation - bodyA.rotation - joint.referenceAngle);
+
+			glm::vec2 pA = getWorldAnchor(bodyA, joint.localAnchorA);
+			glm::vec2 pB = getWorldAnchor(bodyB, joint.localAnchorB);
+			glm::vec2 normal = perpendicular(CoreMath::rotatePoint(joint.localAxisA, bodyA.rotation));
+			solvePositional(bodyA, bodyB, pA - bodyA.position, pB - bodyB.position, normal, glm::dot(pB - pA, normal), 0.0f);
+			break;
+		}
+		case ConstraintType::WeldJoint:
+		{
+			const WeldJoint& joint = constraints->getWeldJoints()[id.index];
+			XpbdBody& bodyA = bodies[joint.bodyA->bodyIndex];
+			XpbdBody& bodyB = bodies[joint.bodyB->bodyIndex];
+			solveAngular(bodyA, bodyB, bodyB.rotation - bodyA.rotation - joint.referenceAngle);
+			solveDistance(bodyA, bodyB, joint.localAnchorA, joint.localAnchorB, 0.0f, 0.0f);
+			break;
+		}
+		case ConstraintType::SoftSpring:
+		{
+			const SoftSpringJoint& joint = constraints->getSoftSprings()[id.index];
+			if (joint.frequency <= 0.0f)
+			{
+				break;
+			}
+
+			XpbdBody& bodyA = bodies[joint.bodyA->bodyIndex];
+			XpbdBody& bodyB = bodies[joint.bodyB->bodyIndex];
+			glm::vec2 pA = getWorldAnchor(bodyA, joint.localAnchorA);
+			glm::vec2 pB = getWorldAnchor(bodyB, joint.localAnchorB);
+			glm::vec2 dpos = pB - pA;
+			float length = glm::length(dpos);
+			if (length == 0.0f)
+			{
+				break;
+			}
+
+			glm::vec2 normal = dpos / length;
+			glm::vec2 rA = pA - bodyA.position;
+			glm::vec2 rB = pB - bodyB.position;
+			float w = getGeneralizedInverseMass(bodyA, rA, normal) + getGeneralizedInverseMass(bodyB, rB, normal);
+			if (w == 0.0f)
+			{
+				break;
+			}
+
+			// Stiffness and damping are scaled by effective mass, so spring keeps its frequency for any bodies
+			float omega = 2.0f * 3.14159265f * joint.frequency;
+			float compliance = w / (omega * omega * substepTime * substepTime);
+			float damping = 2.0f * joint.dampingRatio / (omega * substepTime);
+
+			glm::vec2 anchorShift = (pB - getPreviousWorldAnchor(bodyB, joint.localAnchorB)) - (pA - getPreviousWorldAnchor(bodyA, joint.localAnchorA));
+			float C = length - joint.distance;
+			float lambda = -(C + damping * glm::dot(anchorShift, normal)) / ((1.0f + damping) * w + compliance);
+			applyPositionCorrection(bodyA, bodyB, rA, rB, normal * lambda);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+void XpbdSolver::solveAxisLocks(size_t islandIndex)
+{
+	const AxisConstraints& axisConstraints = constraints->getAxisConstraints();
+
+	for (unsigned int a = axisOffsets[islandIndex]; a < axisOffsets[islandIndex + 1]; a++)
+	{
+		unsigned int i = islandAxes[a];
+		XpbdBody& body = bodies[axisConstraints.bodies[i]->bodyIndex];
+
+		// Lock has zero compliance and only one body, so projection puts body right on locked axis
+		glm::vec2 fixedPosition = axisConstraints.fixedPositions[i] + body.centerOffset;
+		if (axisConstraints.disableX[i])
+		{
+			body.position.x = fixedPosition.x;
+		}
+		if (axisConstraints.disableY[i])
+		{
+			body.position.y = fixedPosition.y;
+		}
+	}
+}
+
+void XpbdSolver::updateVelocities(const std::vector<RigidBody*>& islandBodies, size_t first, size_t last, float substepTime)
+{
+	const float invSubstepTime = 1.0f / substepTime;
+
+	for (size_t i = first; i < last; i++)
+	{
+		XpbdBody& body = bodies[islandBodies[i]->bodyIndex];
+		body.velocity = (body.position - body.previousPosition) * invSubstepTime;
+		body.angularVelocity = (body.rotation - body.previousRotation) * invSubstepTime;
+	}
+}
+
+void XpbdSolver::solveContactVelocities(size_t first, size_t last, float substepTime)
+{
+	const float invSubstepTime = 1.0f / substepTime;
+
+	for (size_t c = first; c < last; c++)
+	{
+		XpbdContact& contact = contacts[c];
+		XpbdBody& bodyA = bodies[contact.indexA];
+		XpbdBody& bodyB = bodies[contact.indexB];
+		const glm::vec2& normal = contact.normal;
+
+		for (unsigned int i = 0; i < contact.countOfContacts; i++)
+		{
+			XpbdContactPoint& point = contact.points[i];
+			if (point.normalLambda <= 0.0f)
+			{
+				continue;
+			}
+			point.touched = true;
+
+			const glm::vec2& rA = point.rA;
+			const glm::vec2& rB = point.rB;
+
+			// Dynamic friction impulse is limited by normal impulse of this substep
+			glm::vec2 relativeVelocity = getRelativeVelocity(bodyA, bodyB, rA, rB);
+			glm::vec2 tangentVelocity = relativeVelocity - normal * glm::dot(relativeVelocity, normal);
+			float tangentSpeed = glm::length(tangentVelocity);
+			if (tangentSpeed > 0.0f)
+			{
+				glm::vec2 tangent = tangentVelocity / tangentSpeed;
+				float w = getGeneralizedInverseMass(bodyA, rA, tangent) + getGeneralizedInverseMass(bodyB, rB, tangent);
+				if (w > 0.0f)
+				{
+					float impulse = fminf(contact.dynamicFriction * point.normalLambda * invSubstepTime, tangentSpeed / w);
+					applyVelocityCorrection(bodyA, bodyB, rA, rB, -tangent * impulse);
+				}
+			}
+
+			// Separating velocity of projected point comes from pushout of this substep, so it's removed, and bodies don't keep moving apart after overlap is resolved.
+			// Bounce is added once per step by restitution
+			float normalVelocity = glm::dot(getRelativeVelocity(bodyA, bodyB, rA, rB), normal);
+			if (normalVelocity <= 0.0f)
+			{
+				continue;
+			}
+
+			float w = getGeneralizedInverseMass(bodyA, rA, normal) + getGeneralizedInverseMass(bodyB, rB, normal);
+			if (w == 0.0f)
+			{
+				continue;
+			}
+
+			applyVelocityCorrection(bodyA, bodyB, rA, rB, normal * ((0.0f - normalVelocity) / w));
+		}
+	}
+}
+
+void XpbdSolver::applyRestitution(size_t first, size_t last)
+{
+	for (size_t c = first; c < last; c++)
+	{
+		XpbdContact& contact = contacts[c];
+		XpbdBody& bodyA = bodies[contact.indexA];
+		XpbdBody& bodyB = bodies[contact.indexB];
+		const glm::vec2& normal = contact.normal;
+
+		for (unsigned int i = 0; i < contact.countOfContacts; i++)
+		{
+			const XpbdContactPoint& point = contact.points[i];
+			if (point.restitutionVelocity == 0.0f || !point.touched)
+			{
+				continue;
+			}
+
+			// Contact, that already separates faster, isn't slowed down
+			float normalVelocity = glm::dot(getRelativeVelocity(bodyA, bodyB, point.rA, point.rB), normal);
+			if (normalVelocity >= point.restitutionVelocity)
+			{
+				continue;
+			}
+
+			float w = getGeneralizedInverseMass(bodyA, point.rA, normal) + getGeneralizedInverseMass(bodyB, point.rB, normal);
+			if (w == 0.0f)
+			{
+				continue;
+			}
+
+			applyVelocityCorrection(bodyA, bodyB, point.rA, point.rB, normal * ((point.restitutionVelocity - normalVelocity) / w));
+		}
+	}
+}
+
+void XpbdSolver::finish(const std::vector<RigidBody*>& bodies)
+{
+	for (const auto& body : bodies)
+	{
+		if (!body->isAwake())
+		{
+			continue;
+		}
+
+		const XpbdBody& xpbdBody = this->bodies[body->bodyIndex];
+		body->setVelocity(xpbdBody.velocity);
+		body->setAngularVelocity(xpbdBody.angularVelocity);
+		body->moveAndRotate(xpbdBody.position - body->getCenterOfMass(), xpbdBody.rotation - body->getRotation());
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "IslandBuilder.h"
+#include "Physics/Bodies/MaterialTable.h"
+#include "Physics/Collision/Collisions.h"
+#include "Physics/Constraints/ConstraintStorage.h"
+
+#include <vector>
+
+// Pose and velocity of body during position based step. Resting bodies get zero inverse mass, so they are never moved
+struct XpbdBody
+{
+	glm::vec2 position; // Center of mass
+	float rotation;
+	glm::vec2 previousPosition;
+	float previousRotation;
+	glm::vec2 startPosition;
+	float startRotation;
+	glm::vec2 velocity;
+	float angularVelocity;
+	float invMass, invInertia;
+	glm::vec2 centerOffset; // From body's position to center of mass
+};
+
+// Normal and arms are fixed for whole step, like in soft contacts. Separation is estimated from pose change every substep.
+// Arms aren't rotated with bodies, otherwise fast spinning circle would look like it overlaps
+struct XpbdContactPoint
+{
+	glm::vec2 rA, rB; // From centers of mass to contact point at start of step
+	float separation;
+	float restitutionVelocity; // Bounce of contact, that approached faster than threshold at start of step, zero for others
+	float normalLambda; // Of current substep
+	bool touched; // Was pushed during step, only such contacts bounce
+};
+
+struct XpbdContact
+{
+	unsigned int indexA, indexB;
+	glm::vec2 normal;
+	float staticFriction, dynamicFriction, elasticity;
+	XpbdContactPoint points[2];
+	unsigned int countOfContacts;
+	float normalLambdaSum; // Of all points since start of step
+	glm::vec2 frictionSum; // Static friction applied since start of step
+};
+
+// Position based dynamics with compliant constraints (XPBD). Every substep predicts poses, projects each constraint once and derives velocities from pose change.
+// Lagrange multipliers start from zero every substep, so nothing is warm started
+class XpbdSolver
+{
+	// Limit of condition number of two point contact. Worse conditioned pairs are projected point by point
+	const float MAX_BLOCK_CONDITION_NUMBER = 1000.0f;
+
+	// Bodies are separated by moving them, so depth projected per substep is limited to this speed. Velocity gained from pushout is removed by velocity pass
+	const float MAX_PUSHOUT_VELOCITY = 1.0f;
+
+	std::vector<XpbdBody> bodies;
+	std::vector<XpbdContact> contacts; // In manifold order, so islands address them by manifold ranges
+
+	// Springs and axis locks of each island are stored contiguously, offsets have one extra element at the end
+	std::vector<unsigned int> islandSprings, springOffsets;
+	std::vector<unsigned int> islandAxes, axisOffsets;
+
+	ConstraintStorage* constraints = nullptr;
+
+	void integrate(const std::vector<RigidBody*>& islandBodies, size_t first, size_t last, const glm::vec2& acceleration, float substepTime);
+	void solveContactPositions(size_t first, size_t last, float substepTime);
+	bool solveNormalBlock(XpbdContact& contact, const float separations[2]);
+	void solveSprings(size_t islandIndex, float substepTime);
+	void solveJoints(const std::vector<ConstraintId>& joints, size_t first, size_t last, float substepTime);
+	void solveAxisLocks(size_t islandIndex);
+	void updateVelocities(const std::vector<RigidBody*>& islandBodies, size_t first, size_t last, float substepTime);
+	void solveContactVelocities(size_t first, size_t last, float substepTime);
+	void applyRestitution(size_t first, size_t last);
+public:
+	// Takes manifolds and constraints after islands were built. Angular velocity constraints aren't position based, they are applied before step.
+	// Contacts, that approach slower than restitution threshold, don't bounce, so resting bodies don't jitter
+	void prepare(const std::vector<CollisionManifold>& manifolds, const std::vector<RigidBody*>& bodies, ConstraintStorage& constraints, const std::vector<Island>& islands, const MaterialTable& materials, float restitutionThreshold);
+
+	// Islands don't share dynamic bodies, so they may be solved in parallel
+	void solveIsland(const Island& island, size_t islandIndex, const std::vector<RigidBody*>& islandBodies, const std::vector<ConstraintId>& islandJoints, const glm::vec2& gravity, float timeStep, unsigned int substepCount);
+
+	// Writes velocities and pose change back to awake bodies
+	void finish(const std::vector<RigidBody*>& bodies);
+};
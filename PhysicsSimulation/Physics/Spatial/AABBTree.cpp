@@ -0,0 +1,95 @@
+#include "AABBTree.h"
+
+#include <algorithm>
+
+int AABBTree::buildRecursive(const std::vector<AABB>& boxes, std::vector<int>& items, size_t begin, size_t end)
+{
+    int nodeIndex = (int)nodes.size();
+    nodes.emplace_back();
+
+    AABB bounds = boxes[items[begin]];
+    for (size_t i = begin + 1; i < end; i++)
+    {
+        const AABB& box = boxes[items[i]];
+        bounds.min = glm::min(bounds.min, box.min);
+        bounds.max = glm::max(bounds.max, box.max);
+    }
+    nodes[nodeIndex].bounds = bounds;
+
+    if (end - begin == 1)
+    {
+        nodes[nodeIndex].item = items[begin];
+        return nodeIndex;
+    }
+
+    // Split at median along the longest axis
+    glm::vec2 extents = bounds.max - bounds.min;
+    int axis = extents.x >= extents.y ? 0 : 1;
+
+    size_t middle = (begin + end) / 2;
+    std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end, [&boxes, axis](int a, int b)
+        {
+            return boxes[a].min[axis] + boxes[a].max[axis] < boxes[b].min[axis] + boxes[b].max[axis];
+        });
+
+    int left = buildRecursive(boxes, items, begin, middle);
+    int right = buildRecursive(boxes, items, middle, end);
+
+    nodes[nodeIndex].left = left;
+    nodes[nodeIndex].right = right;
+    return nodeIndex;
+}
+
+void AABBTree::build(const std::vector<AABB>& boxes)
+{
+    nodes.clear();
+    if (boxes.empty())
+    {
+        return;
+    }
+
+    nodes.reserve(boxes.size() * 2 - 1);
+
+    std::vector<int> items(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        items[i] = (int)i;
+    }
+
+    buildRecursive(boxes, items, 0, boxes.size());
+}
+
+void AABBTree::query(const AABB& searchAABB, std::vector<int>& outItems) const
+{
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = nodes[stack[--stackSize]];
+        if (!node.bounds.isIntersecting(searchAABB))
+        {
+            continue;
+        }
+
+        if (node.item >= 0)
+        {
+            outItems.push_back(node.item);
+            continue;
+        }
+
+        stack[stackSize++] = node.left;
+        stack[stackSize++] = node.right;
+    }
+}
+
+bool AABBTree::isEmpty() const
+{
+    return nodes.empty();
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "Core/AABB.h"
+#include <vector>
+
+// Static bounding volume hierarchy over a small set of boxes. Built once, queried many times.
+// Used as midphase for compound bodies, so only children near the other body are tested.
+class AABBTree
+{
+    struct Node
+    {
+        AABB bounds;
+        int left = -1;
+        int right = -1;
+        int item = -1; // Index of the box for leaves, -1 for inner nodes
+    };
+
+    std::vector<Node> nodes;
+
+    int buildRecursive(const std::vector<AABB>& boxes, std::vector<int>& items, size_t begin, size_t end);
+public:
+    AABBTree() = default;
+
+    void build(const std::vector<AABB>& boxes);
+    void query(const AABB& searchAABB, std::vector<int>& outItems) const;
+
+    bool isEmpty() const;
+};
@@ -31,7 +31,7 @@ void Quadtree::clear()
     root->clear();
 }
 
-void Quadtree::rebuild(std::vector<std::unique_ptr<RigidBody>>& bodies)
+void Quadtree::rebuild(const std::vector<RigidBody*>& bodies)
 {
     PROFILE_FUNCTION();
 
@@ -46,7 +46,7 @@ void Quadtree::rebuild(std::vector<std::unique_ptr<RigidBody>>& bodies)
         // Only insert bodies that are within world bounds
         if (worldBounds.isIntersecting(body->getAABB_noUpdate()))
         {
-            root->insert(body.get());
+            root->insert(body);
         }
     }
 }
@@ -70,7 +70,7 @@ void Quadtree::getPotentialCollisions(std::vector<RigidBodyPair>& pairs) const
     {
         RigidBody* bodyA = allBodies[i];
         const AABB& bodyA_AABB = bodyA->getAABB_noUpdate();
-        const bool isBodyAStatic = bodyA->isStatic();
+        const bool isBodyAAwake = bodyA->isAwake();
 
         candidates.clear();
         root->retrieve(candidates, bodyA_AABB);
@@ -82,7 +82,7 @@ void Quadtree::getPotentialCollisions(std::vector<RigidBodyPair>& pairs) const
                 continue;
             }
 
-            if (isBodyAStatic && bodyB->isStatic())
+            if (!isBodyAAwake && !bodyB->isAwake())
             {
                 continue;
             }
@@ -53,7 +53,7 @@ public:
     Quadtree(const AABB& worldBounds);
 
     void clear();
-    void rebuild(std::vector<std::unique_ptr<RigidBody>>& bodies);
+    void rebuild(const std::vector<RigidBody*>& bodies);
     void getPotentialCollisions(std::vector<RigidBodyPair>& pairs) const;
 
     void getAllBounds(std::vector<AABB>& bounds) const;
@@ -68,7 +68,7 @@ void SpatialHashGrid::clear()
     }
 }
 
-void SpatialHashGrid::rebuild(std::vector<std::unique_ptr<RigidBody>>& bodies)
+void SpatialHashGrid::rebuild(const std::vector<RigidBody*>& bodies)
 {
     clear();
 
@@ -77,7 +77,7 @@ void SpatialHashGrid::rebuild(std::vector<std::unique_ptr<RigidBody>>& bodies)
     // Insert all bodies into the grid
     for (auto& body : bodies)
     {
-        addBodyToCells(body.get());
+        addBodyToCells(body);
     }
 }
 
@@ -105,14 +105,14 @@ void SpatialHashGrid::getPotentialCollisions(std::vector<RigidBodyPair>& pairs)
         {
             RigidBody* bodyA = cellBodies[i];
             const AABB& bodyA_AABB = bodyA->getAABB_noUpdate();
-            const bool isBodyAStatic = bodyA->isStatic();
+            const bool isBodyAAwake = bodyA->isAwake();
 
             for (size_t j = i + 1; j < bodiesCount; j++)
             {
                 RigidBody* bodyB = cellBodies[j];
-                const bool isBodyBStatic = bodyB->isStatic();
+                const bool isBodyBAwake = bodyB->isAwake();
 
-                if (isBodyAStatic && isBodyBStatic)
+                if (!isBodyAAwake && !isBodyBAwake)
                 {
                     continue;
                 }
@@ -51,7 +51,7 @@ public:
     SpatialHashGrid(const AABB& worldBounds, float cellSize);
 
     void clear();
-    void rebuild(std::vector<std::unique_ptr<RigidBody>>& bodies);
+    void rebuild(const std::vector<RigidBody*>& bodies);
     void getPotentialCollisions(std::vector<RigidBodyPair>& pairs) const;
 
     // Visualization helpers
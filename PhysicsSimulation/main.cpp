@@ -12,31 +12,49 @@
 
 #include "Input/InputManager.h"
 
-static void drawBodies(const std::vector<std::unique_ptr<RigidBody>>& bodies)
+static void drawBodies(const std::vector<RigidBody*>& bodies)
 {
-    for (const auto& body : bodies)
+    for (const RigidBody* body : bodies)
     {
+        // Sleeping bodies are dimmed
+        glm::vec3 color = body->isSleeping() ? glm::vec3(0.6f, 0.6f, 0.7f) : glm::vec3(1.0f, 1.0f, 1.0f);
+
         if (body->shapeType == ShapeType::Circle)
         {
-            RigidCircle* circle = dynamic_cast<RigidCircle*>(body.get());
+            const RigidCircle* circle = dynamic_cast<const RigidCircle*>(body);
 
-            ShapeRenderer::drawCircle(circle->position, circle->radius, { 1.0f, 1.0f, 1.0f });
+            ShapeRenderer::drawCircle(circle->getPosition(), circle->radius, color);
 
-            float cos_ = cosf(body->rotation);
-            float sin_ = sinf(body->rotation);
+            float cos_ = cosf(body->getRotation());
+            float sin_ = sinf(body->getRotation());
             std::vector<glm::vec2> vertices
             {
-                circle->position, circle->position + glm::vec2(cos_, sin_) * circle->radius
+                circle->getPosition(), circle->getPosition() + glm::vec2(cos_, sin_) * circle->radius
             };
 
             ShapeRenderer::drawPolygon(vertices, { 0.0f, 0.0f, 0.0f }, true);
         }
         else if (body->shapeType == ShapeType::Polygon)
         {
-            RigidPolygon* polygon = dynamic_cast<RigidPolygon*>(body.get());
+            const RigidPolygon* polygon = dynamic_cast<const RigidPolygon*>(body);
             const auto& vertices = polygon->getTransformedVertices();
 
-            ShapeRenderer::drawPolygon(vertices, { 1.0f, 1.0f, 1.0f });
+            ShapeRenderer::drawPolygon(vertices.data(), vertices.size(), color);
+        }
+        else if (body->shapeType == ShapeType::Compound)
+        {
+            const RigidCompound* compound = dynamic_cast<const RigidCompound*>(body);
+            for (const auto& child : compound->getChildren())
+            {
+                if (child.shapeType == ShapeType::Circle)
+                {
+                    ShapeRenderer::drawCircle(child.transformedCenter, child.radius, color);
+                }
+                else
+                {
+                    ShapeRenderer::drawPolygon(child.transformedVertices.data(), child.transformedVertices.size(), color);
+                }
+            }
         }
 
         // Center of mass
@@ -107,9 +125,16 @@ int main()
     // Simulation
     Simulation simulation;
 
+    // Bodies, thrown out of the world, are removed
+    {
+        KillVolume killVolume = simulation.getKillVolume();
+        killVolume.policy = KillVolumePolicy::Remove;
+        simulation.setKillVolume(killVolume);
+    }
+
     // Materials
-    std::unique_ptr<Material> materialLevel = std::make_unique<Material>(0.0f, 0.0f, 0.0f);
-    std::unique_ptr<Material> materialBody = std::make_unique<Material>(0.8f, 0.6f, 0.4f);
+    MaterialId materialLevel = simulation.getMaterialTable().addMaterial(Material(0.0f, 0.0f, 0.0f));
+    MaterialId materialBody = simulation.getMaterialTable().addMaterial(Material(0.8f, 0.6f, 0.4f));
 
     // Level boxes
     {
@@ -120,10 +145,10 @@ int main()
         float mass = 0.0f;
         float inertia = 0.0f;
 
-        simulation.addBox({ 0.0f , -(height + thickness * 0.5f) }, { 0.0f, 0.0f }, 0.0f, 0.0f, mass, inertia, materialLevel.get(), {width * 2.0f, thickness});
-        simulation.addBox({ 0.0f , (height + thickness * 0.5f) }, { 0.0f, 0.0f }, 0.0f, 0.0f, mass, inertia, materialLevel.get(), { width * 2.0f, thickness });
-        simulation.addBox({ -(width + thickness * 0.5f), 0.0f }, { 0.0f, 0.0f }, 0.0f, 0.0f, mass, inertia, materialLevel.get(), { thickness, height * 2.0f });
-        simulation.addBox({ (width + thickness * 0.5f), 0.0f }, { 0.0f, 0.0f }, 0.0f, 0.0f, mass, inertia, materialLevel.get(), { thickness, height * 2.0f });
+        simulation.addBox({ 0.0f , -(height + thickness * 0.5f) }, { 0.0f, 0.0f }, 0.0f, 0.0f, mass, inertia, materialLevel, {width * 2.0f, thickness});
+        simulation.addBox({ 0.0f , (height + thickness * 0.5f) }, { 0.0f, 0.0f }, 0.0f, 0.0f, mass, inertia, materialLevel, { width * 2.0f, thickness });
+        simulation.addBox({ -(width + thickness * 0.5f), 0.0f }, { 0.0f, 0.0f }, 0.0f, 0.0f, mass, inertia, materialLevel, { thickness, height * 2.0f });
+        simulation.addBox({ (width + thickness * 0.5f), 0.0f }, { 0.0f, 0.0f }, 0.0f, 0.0f, mass, inertia, materialLevel, { thickness, height * 2.0f });
     }
 
     {
@@ -133,7 +158,7 @@ int main()
 
         float density = 600.0f;
 
-        auto rotatingBox = simulation.addBox({ 0.0f, 0.0f }, { 0.0f, 0.0f }, 0.0f, 0.0f, 0.0f, 0.0f, materialBody.get(), { width, height }, density);
+        auto rotatingBox = simulation.addBox({ 0.0f, 0.0f }, { 0.0f, 0.0f }, 0.0f, 0.0f, 0.0f, 0.0f, materialBody, { width, height }, density);
         simulation.addAxisConstraint(rotatingBox, true, true);
         simulation.addAngularVelocityConstraint(rotatingBox, 4.0f);
     }
@@ -143,6 +168,7 @@ int main()
     double uiUpdateTime = previousTime;
     int frameCount = 0;
     int updatesCount = 0;
+    size_t culledCount = 0;
 
     double perfomancePrintTime = previousTime + 1.0f;
 
@@ -184,7 +210,7 @@ int main()
 
                 float density = 600.0f;
 
-                simulation.addBox(position, { vx, vy }, rot, angVel, 0.0f, 0.0f, materialBody.get(), { w, h }, density);
+                simulation.addBox(position, { vx, vy }, rot, angVel, 0.0f, 0.0f, materialBody, { w, h }, density);
             }
             if (click.isRightButton() && click.isPressed())
             {
@@ -204,7 +230,7 @@ int main()
                 {
                     glm::vec2 dpos = { Random::Float(-1.0f, 1.0f), Random::Float(-1.0f, 1.0f) };
                     dpos *= radius * 3.0f;
-                    simulation.addCircle(position + dpos, { vx, vy }, rot, angVel, 0.0f, 0.0f, materialBody.get(), radius, density);
+                    simulation.addCircle(position + dpos, { vx, vy }, rot, angVel, 0.0f, 0.0f, materialBody, radius, density);
                 }
             }
             if (click.isMiddleButton() && click.isPressed())
@@ -217,8 +243,6 @@ int main()
                 float rot = 0.0f;
                 float angVel = 0.0f;
 
-                Material material(0.8f, 0.6f, 0.4f);
-
                 float density = 600.0f;
 
                 int verticesCount = Random::Int(3, 10);
@@ -247,7 +271,7 @@ int main()
                 }
 
                 //
-                auto body = simulation.addPolygon(position, { vx, vy }, rot, angVel, 0.0f, 0.0f, materialBody.get(), vertices, density);
+                auto body = simulation.addPolygon(position, { vx, vy }, rot, angVel, 0.0f, 0.0f, materialBody, vertices, density);
                 //simulation.addAxisConstraint(body, true, true);
             }
         }
@@ -263,6 +287,27 @@ int main()
                     camera.setZoom(1.0f);
                 }
             }
+            else if (key.key == GLFW_KEY_F)
+            {
+                if (key.isPressed())
+                {
+                    // Spawn cart: one body made of a box and two wheels
+                    double xpos, ypos;
+                    glfwGetCursorPos(GraphicsManager::getWindow(), &xpos, &ypos);
+                    glm::vec2 position = GraphicsManager::screenToWorld({ xpos, ypos });
+
+                    std::vector<CompoundShape> shapes =
+                    {
+                        CompoundShape::box({ 0.0f, 0.0f }, { 0.4f, 0.1f }),
+                        CompoundShape::circle({ -0.15f, -0.07f }, 0.05f),
+                        CompoundShape::circle({ 0.15f, -0.07f }, 0.05f),
+                    };
+
+                    float density = 600.0f;
+
+                    simulation.addCompound(position, { 0.0f, 0.0f }, 0.0f, 0.0f, 0.0f, 0.0f, materialBody, shapes, density);
+                }
+            }
             else if (key.key == GLFW_KEY_T)
             {
                 if (key.isPressed())
@@ -272,6 +317,15 @@ int main()
                     simulation.setCollisionDetectionMethod((CollisionDetectionMethod)nextmethod);
                 }
             }
+            else if (key.key == GLFW_KEY_G)
+            {
+                if (key.isPressed())
+                {
+                    int type = (int)simulation.getSolverType();
+                    int nextType = (type + 1) % (int)SolverType::_COUNT;
+                    simulation.setSolverType((SolverType)nextType);
+                }
+            }
         }
 
         InputManager::clearInputs();
@@ -315,6 +369,7 @@ int main()
 
         // Simulation
 		updatesCount += simulation.update(deltaTime);
+        culledCount += simulation.getKillVolumeEvents().size();
 
         // Profiler
         if (currentTime > perfomancePrintTime)
@@ -350,8 +405,8 @@ int main()
             frameCount = 0;
             updatesCount = 0;
 
-            char title[64];
-            snprintf(title, sizeof(title), "Physics simulation - FPS: %.1f - UPS: %.1f - BODIES: %i", fps, ups, (int)bodiesCount);
+            char title[96];
+            snprintf(title, sizeof(title), "Physics simulation - FPS: %.1f - UPS: %.1f - BODIES: %i - CULLED: %i", fps, ups, (int)bodiesCount, (int)culledCount);
             GraphicsManager::setTitle(title);
         }
         frameCount++;
@@ -364,9 +419,6 @@ int main()
     return 0;
 }
 
-// TODO: Store same shape bodies on same vector. They should have move semantics for avoiding copies if new part is added or removed.
-// TODO: Have separate vector that stores memory-safe pointers to all shapes.
-// 
 // TODO: Have optimization for boxes. You have to do less calculations for SAT.
 // TODO: Check if object's AABB crosses screen's AABB to determine, draw or not?
 // TODO: Batch shapes of same type to reduce drawcalls. Follow order!
@@ -375,6 +427,4 @@ int main()
 // TODO: Objects stacked atop of each other tend up to push objects above them away.
 //
 // TODO: Calculate body's mass center for correctly applying forces.
-// TODO: Simulation supports only convex polygon. Add support for concave ones.
-// TODO: Add sleeping
 // TODO: Maybe combine friction using: sqrt(fric1 * fric2)
\ No newline at end of file